@@ -0,0 +1,280 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// Compressed universe frames on the serial line, sent by the controller app when
+// "Komprimierte Frames" is enabled. Text messages ("\x01cmd:value;") are unchanged
+// and can be interleaved between frames.
+//
+//   0x02 | type | sequence | length (2, little endian) | payload | checksum
+//
+// checksum is the 8 bit sum of type, sequence, length and payload. Every payload
+// starts with the slot count (2 bytes, little endian), followed by
+//   DMX_FRAME_KEY:    all slots
+//   DMX_FRAME_BITMAP: (count + 7) / 8 bitmap bytes (bit i set = slot i changed,
+//                     LSB first), then the values of the changed slots in order
+//   DMX_FRAME_RLE:    tokens of <skip> <run> <run values>: skip unchanged slots,
+//                     then overwrite the next run slots. Trailing slots are unchanged.
+// Deltas apply to the frame with the previous sequence number only. After a
+// lost or corrupt frame the decoder ignores deltas until the next keyframe.
+#define DMX_FRAME_START 0x02
+#define DMX_FRAME_KEY 0
+#define DMX_FRAME_BITMAP 1
+#define DMX_FRAME_RLE 2
+#define DMX_FRAME_TYPES 3
+#define DMX_FRAME_MAX_SLOTS 512
+#define DMX_FRAME_MAX_PAYLOAD 1024
+#define DMX_FRAME_MAX_RUN 255
+// start, type, sequence, length and checksum
+#define DMX_FRAME_OVERHEAD 6
+
+// Reference decoder, written for the Arduino side: no allocation, no STL and
+// about 600 bytes of RAM. Payload bytes are applied to 'slots' as they arrive, so
+// nothing but the bitmap is buffered. A frame that fails the checksum may have
+// been applied partially, which is why it also drops sync until the next keyframe.
+//
+//   DMXFrameDecoder decoder;
+//   while (Serial.available()) {
+//       uint8_t b = Serial.read();
+//       if (!decoder.Feed(b)) parseTextMessage(b);
+//       if (decoder.frameReady) { decoder.frameReady = false; writeDmx(decoder.slots, decoder.slotCount); }
+//   }
+class DMXFrameDecoder
+{
+public:
+	uint8_t slots[DMX_FRAME_MAX_SLOTS];
+	uint16_t slotCount;
+	// Set when a frame was applied completely, cleared by the caller
+	bool frameReady;
+	uint32_t framesApplied;
+	uint32_t framesDropped;
+
+	DMXFrameDecoder()
+	{
+		memset(slots, 0, sizeof(slots));
+		slotCount = 0;
+		frameReady = false;
+		framesApplied = 0;
+		framesDropped = 0;
+		m_State = STATE_IDLE;
+		m_InSync = false;
+		m_LastSequence = 0;
+	}
+
+	// Returns true for every byte that belongs to a compressed frame, the start byte included
+	bool Feed(uint8_t byte)
+	{
+		switch (m_State)
+		{
+		case STATE_IDLE:
+			if (byte != DMX_FRAME_START)
+			{
+				return false;
+			}
+			m_State = STATE_TYPE;
+			return true;
+		case STATE_TYPE:
+			m_Type = byte;
+			m_Checksum = byte;
+			m_State = byte < DMX_FRAME_TYPES ? STATE_SEQUENCE : STATE_IDLE;
+			return true;
+		case STATE_SEQUENCE:
+			m_Sequence = byte;
+			m_Checksum += byte;
+			// A delta only fits on top of the frame right before it
+			m_Apply = m_Type == DMX_FRAME_KEY || (m_InSync && m_Sequence == (uint8_t)(m_LastSequence + 1));
+			m_State = STATE_LENGTH_LO;
+			return true;
+		case STATE_LENGTH_LO:
+			m_Length = byte;
+			m_Checksum += byte;
+			m_State = STATE_LENGTH_HI;
+			return true;
+		case STATE_LENGTH_HI:
+			m_Length |= (uint16_t)byte << 8;
+			m_Checksum += byte;
+			m_Received = 0;
+			m_Valid = m_Length >= 2 && m_Length <= DMX_FRAME_MAX_PAYLOAD;
+			m_State = m_Valid ? STATE_PAYLOAD : STATE_IDLE;
+			if (!m_Valid)
+			{
+				Drop();
+			}
+			return true;
+		case STATE_PAYLOAD:
+			m_Checksum += byte;
+			Payload(byte);
+			if (++m_Received == m_Length)
+			{
+				m_State = STATE_CHECKSUM;
+			}
+			return true;
+		case STATE_CHECKSUM:
+			m_State = STATE_IDLE;
+			if (m_Apply && m_Valid && byte == m_Checksum && Complete())
+			{
+				m_InSync = true;
+				m_LastSequence = m_Sequence;
+				slotCount = m_Count;
+				frameReady = true;
+				framesApplied++;
+			}
+			else
+			{
+				Drop();
+			}
+			return true;
+		}
+		m_State = STATE_IDLE;
+		return false;
+	}
+
+private:
+	enum
+	{
+		STATE_IDLE,
+		STATE_TYPE,
+		STATE_SEQUENCE,
+		STATE_LENGTH_LO,
+		STATE_LENGTH_HI,
+		STATE_PAYLOAD,
+		STATE_CHECKSUM
+	};
+	enum
+	{
+		RLE_SKIP,
+		RLE_RUN,
+		RLE_VALUES
+	};
+
+	uint8_t m_State;
+	uint8_t m_Type;
+	uint8_t m_Sequence;
+	uint8_t m_LastSequence;
+	uint8_t m_Checksum;
+	bool m_InSync;
+	bool m_Apply;
+	bool m_Valid;
+	uint16_t m_Length;
+	uint16_t m_Received;
+	uint16_t m_Count;
+	uint16_t m_Index;
+	uint8_t m_Bitmap[DMX_FRAME_MAX_SLOTS / 8];
+	uint16_t m_BitmapSize;
+	uint8_t m_RleState;
+	uint8_t m_Run;
+
+	void Drop()
+	{
+		m_InSync = false;
+		framesDropped++;
+	}
+
+	void Write(uint8_t value)
+	{
+		if (m_Index >= m_Count)
+		{
+			m_Valid = false;
+			return;
+		}
+		if (m_Apply)
+		{
+			slots[m_Index] = value;
+		}
+		m_Index++;
+	}
+
+	uint16_t NextChanged(uint16_t from)
+	{
+		while (from < m_Count && !(m_Bitmap[from >> 3] & (1 << (from & 7))))
+		{
+			from++;
+		}
+		return from;
+	}
+
+	void Payload(uint8_t byte)
+	{
+		if (m_Received == 0)
+		{
+			m_Count = byte;
+			return;
+		}
+		if (m_Received == 1)
+		{
+			m_Count |= (uint16_t)byte << 8;
+			if (m_Count > DMX_FRAME_MAX_SLOTS)
+			{
+				m_Valid = false;
+				m_Count = DMX_FRAME_MAX_SLOTS;
+			}
+			m_Index = 0;
+			m_BitmapSize = (m_Count + 7) / 8;
+			m_RleState = RLE_SKIP;
+			if (m_Type == DMX_FRAME_BITMAP && m_BitmapSize == 0)
+			{
+				m_Index = m_Count;
+			}
+			return;
+		}
+
+		uint16_t position = m_Received - 2;
+		switch (m_Type)
+		{
+		case DMX_FRAME_KEY:
+			Write(byte);
+			break;
+		case DMX_FRAME_BITMAP:
+			if (position < m_BitmapSize)
+			{
+				m_Bitmap[position] = byte;
+				if (position + 1 == m_BitmapSize)
+				{
+					m_Index = NextChanged(0);
+				}
+			}
+			else
+			{
+				Write(byte);
+				m_Index = NextChanged(m_Index);
+			}
+			break;
+		case DMX_FRAME_RLE:
+			if (m_RleState == RLE_SKIP)
+			{
+				// Clamped, so a run of skips can not wrap the index back into range
+				m_Index = m_Index + byte > m_Count ? m_Count : m_Index + byte;
+				m_RleState = RLE_RUN;
+			}
+			else if (m_RleState == RLE_RUN)
+			{
+				m_Run = byte;
+				m_RleState = m_Run > 0 ? RLE_VALUES : RLE_SKIP;
+			}
+			else
+			{
+				Write(byte);
+				if (--m_Run == 0)
+				{
+					m_RleState = RLE_SKIP;
+				}
+			}
+			break;
+		}
+	}
+
+	// The payload must have ended exactly where its structure says
+	bool Complete()
+	{
+		switch (m_Type)
+		{
+		case DMX_FRAME_KEY:
+			return m_Index == m_Count;
+		case DMX_FRAME_BITMAP:
+			return m_Received >= 2 + m_BitmapSize && m_Index == m_Count;
+		case DMX_FRAME_RLE:
+			return m_RleState != RLE_VALUES;
+		}
+		return false;
+	}
+};
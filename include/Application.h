@@ -1,10 +1,22 @@
 #pragma once
 #include <SerialComm.h>
+#include <OutputScheduler.h>
+#include <SerialOutput.h>
+#include <NetworkOutput.h>
+#include <RecordingOutput.h>
+#include <NullOutput.h>
+#include <Clock.h>
+#include <NetworkReceiver.h>
+#include <DeviceDiscovery.h>
+#include <SceneStore.h>
+#include <ScriptEngine.h>
+#include <PixelMapper.h>
+#include <ColorPipeline.h>
+#include <ControlInput.h>
 #include <vector>
-
-#define CONN_STATUS_NOT_CONNECTED 0
-#define CONN_STATUS_CONNECTING 1
-#define CONN_STATUS_CONNECTED 2
+#include <string>
+#include <mutex>
+#include <atomic>
 
 #define DMX_RGB 3
 #define DMX_DRGB 4
@@ -16,17 +28,101 @@
 #define CMD_SMOOTHING_SPEED -5
 #define CMD_TARGET_ID -6
 
+#define SCRIPT_ACTIONS_MAX 200
+
+// Controller settings mirrored to the Arduino. Written by the UI and scene recall,
+// read again by the discovery thread when it replays them after a reconnect.
+struct ControlSettings
+{
+	std::atomic<bool> syncMode{ true };
+	std::atomic<bool> smoothing{ false };
+	std::atomic<float> smoothingSpeed{ 0.001f };
+	std::atomic<bool> dmxEnabled{ false };
+};
+
+// Threads and what they own:
+//  - UI thread: the window, all widget state, the script thread handle and
+//    Start/Stop of every component. Only it deletes or replaces components.
+//  - Output thread (OutputScheduler): the front universe buffer and the outputs'
+//    send state, it runs the ScriptEngine frame before every send.
+//  - Script workers: their lua_States and private universe buffers, see ScriptEngine.
+//  - Script thread: the lua_State of a loop-style script until it returns.
+//  - Discovery thread: opening and closing the serial port.
+//  - Control input thread: its sockets, it only hands events to the output thread.
+// In simulation the output thread and the script thread run on the virtual clock
+// instead, which lets exactly one of them run at a time (see VirtualClock).
+// Everything crossing threads is either atomic (flags and settings below, status
+// and counters in the components), published through the scheduler's triple
+// buffer (universe state) or behind a component's own mutex (serial queue, script
+// log). Shutdown stops the producers before the consumers and joins every thread
+// before anything it uses is released.
+
 class Application
 {
 public:
 	static Application* INSTANCE;
 
 	SerialComm comm;
-	int dmxChannels = DMX_RGB;
-	bool running = true;
-	std::vector<std::string> scriptActions;
+	RealClock realClock;
+	VirtualClock virtualClock;
+	// What scripts started from now on wait on, the scheduler has its own reference
+	std::atomic<Clock*> clock{ &realClock };
+	OutputScheduler scheduler{ &realClock };
+	SerialOutput serialOutput{ &comm };
+	NetworkOutput networkOutput;
+	RecordingOutput recordingOutput;
+	NullOutput nullOutput;
+	NetworkReceiver networkReceiver;
+	DeviceDiscovery discovery{ &comm, &serialOutput, &scheduler };
+	SceneStore scenes;
+	ScriptEngine scriptEngine{ &scheduler };
+	PixelMapper pixelMapper{ &scheduler };
+	ColorPipeline colorPipeline{ &scheduler };
+	ControlInput controlInput{ &scheduler };
+	ControlSettings controls;
+	std::atomic<int> dmxChannels{ DMX_RGB };
+	std::atomic<int> targetId{ 0 };
+	// Universe that external faders (OSC /fader, MIDI CC) write to
+	std::atomic<int> controlFaderUniverse{ 0 };
+	// Cleared to stop loop-style scripts (appRunning(), wait())
+	std::atomic<bool> running{ true };
 
 	void Init();
 	void UpdateDMXColors(float* colors);
+	void SendCommand(int command, const std::string& value);
 	void ConnectToArduino();
+	// Runs a script on the script thread, stopping the previous loop-style one
+	void StartScriptThread(const std::string& path);
+	void StopScriptThread();
+	// Replays the selected script on the virtual clock for 'seconds' of show time as
+	// fast as possible. The serial and network outputs are detached meanwhile, frames
+	// go to nullOutput and, with 'record', to a capture at 'path'. Every run starts
+	// from zeroed universes, cleared fixture colors, a stopped pixel mapping, Id 0 and
+	// zero parameters, so checksums of two runs compare; FinishSimulation() restores
+	// the live show before the live outputs are attached again.
+	void StartSimulation(double seconds, bool record, const std::string& path);
+	// Back to the real clock and the live outputs, also cancels a running simulation
+	void FinishSimulation();
+	bool IsSimulating();
+	void ReplayState();
+	void SendControlSettings();
+	Result SaveScene(const std::string& name, int number);
+	Result RecallScene(uint32_t index);
+	void CrossfadeScenes(uint32_t from, uint32_t to, float t);
+	void StartNetworkOutput(int protocol, const std::string& host, int universeCount, int firstUniverse, bool loopback);
+	void StopNetworkOutput();
+	// Decodes the PNGs of a folder into <folder>.sfpx and opens that for pixel mapping
+	Result ImportPixelImages(const std::string& folder, float frameRate);
+	// Safe from any thread, keeps the newest SCRIPT_ACTIONS_MAX entries
+	void AddScriptAction(const std::string& action);
+	void ClearScriptActions();
+private:
+	std::mutex scriptActionsMutex;
+	std::vector<std::string> scriptActions;
+	// Scene recalled by external control on the output thread, its settings are applied by the UI thread
+	std::atomic<uint32_t> pendingSceneSettings{ SCENE_NOT_FOUND };
+
+	// Output thread, at the start of every frame
+	void DispatchControlEvents();
+	void ApplySceneSettings(const SceneSettings& settings);
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Time source for everything that paces the show: the output scheduler and wait()
+// in scripts. Times are microseconds on the clock's own time line.
+//
+// A thread that sleeps on the clock is a participant: it is attached (by whoever
+// starts it, before it starts), calls SleepUntil() before its first step and
+// between steps, and is detached when it is done.
+class Clock
+{
+public:
+	virtual ~Clock() {}
+
+	virtual uint64_t NowMicros() = 0;
+	virtual int Attach() { return 0; }
+	virtual void Detach(int /*participant*/) {}
+	virtual void SleepUntil(int participant, uint64_t micros) = 0;
+	// Ends the participant's current or next SleepUntil() early, callers re-check their deadline
+	virtual void Interrupt(int /*participant*/) {}
+	// Simulated time ignores anything that happens on the wall clock (external input, early frames)
+	virtual bool IsSimulated() { return false; }
+};
+
+// Wall time (steady_clock). Threads that are never interrupted may sleep as participant 0 without attaching.
+class RealClock : public Clock
+{
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::vector<int> m_Interrupted;
+	std::atomic<int> m_NextId;
+public:
+	RealClock();
+
+	uint64_t NowMicros() override;
+	int Attach() override;
+	void Detach(int participant) override;
+	void SleepUntil(int participant, uint64_t micros) override;
+	void Interrupt(int participant) override;
+};
+
+// Simulated time that only moves when every participant is asleep, then jumps to
+// the earliest wake-up. Exactly one participant runs at a time and ties wake in
+// attach order, so a run does the same steps in the same order every time, as
+// fast as the CPU allows.
+class VirtualClock : public Clock
+{
+private:
+	struct Participant
+	{
+		int id;
+		uint64_t wake;
+	};
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::vector<Participant> m_Participants;
+	std::atomic<uint64_t> m_Now;
+	// Participant that is running, -1 while the next one is picked
+	int m_Running;
+	int m_NextId;
+	bool m_Paused;
+
+	// Called with m_Mutex held
+	void Dispatch();
+public:
+	VirtualClock();
+
+	// Back to 0 and paused, only while nothing is attached. Attach everything that
+	// takes part, then Resume(); otherwise the first one could run ahead on its own.
+	void Reset();
+	void Resume();
+
+	uint64_t NowMicros() override { return m_Now; }
+	int Attach() override;
+	void Detach(int participant) override;
+	void SleepUntil(int participant, uint64_t micros) override;
+	bool IsSimulated() override { return true; }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <OutputScheduler.h>
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Channel layouts of a fixture
+#define COLOR_MODE_RGB 0
+#define COLOR_MODE_DRGB 1
+#define COLOR_MODE_RGBW 2
+#define COLOR_MODE_RGBA 3
+
+// Response curves from perceived level to output level
+#define COLOR_CURVE_LINEAR 0
+#define COLOR_CURVE_GAMMA22 1
+#define COLOR_CURVE_GAMMA28 2
+#define COLOR_CURVE_CIE 3
+#define COLOR_CURVE_COUNT 4
+
+#define COLOR_LUT_SIZE 4096
+#define COLOR_MAX_FIXTURES 512
+
+// How one fixture is patched and corrected
+struct ColorProfile
+{
+	uint16_t universe;
+	// 0-based first slot
+	uint16_t start;
+	uint8_t mode;
+	// Every channel is a coarse/fine pair (16 bit)
+	uint8_t fine;
+	uint8_t curve;
+	// White point in Kelvin, 0 leaves the color as is
+	float temperature;
+};
+
+// Colors of all fixtures, see ColorPipeline::SaveColors()
+struct ColorState
+{
+	std::vector<float> red;
+	std::vector<float> green;
+	std::vector<float> blue;
+	std::vector<float> intensity;
+	std::vector<uint8_t> active;
+	std::vector<uint8_t> changed;
+};
+
+// Turns fixture colors (R G B intensity, 0..1) into slots. Each fixture has a
+// profile; fixtures without one use the default mode and sit back to back from
+// slot 0 of universe 0, which is the old targetId * dmxChannels patch.
+//
+// Colors are kept as structure of arrays. When something changed, RunFrame()
+// converts all fixtures in one pass on the output thread: white balance,
+// intensity, white/amber extraction run four fixtures at a time on SSE2, then
+// the response curves (4096 entry LUTs with 16 bit output, interpolated) are
+// applied. Only fixtures that changed since the last pass are written (8 bit or
+// coarse/fine pairs), slots set by a scene recall stay until their fixture changes.
+class ColorPipeline
+{
+private:
+	OutputScheduler* m_Scheduler;
+
+	std::mutex m_Mutex;
+	std::vector<ColorProfile> m_Profiles;
+	std::vector<uint8_t> m_Configured;
+	std::vector<uint8_t> m_Active;
+	// Fixtures whose color or profile changed since the last pass
+	std::vector<uint8_t> m_Changed;
+	uint8_t m_DefaultMode;
+	bool m_Dirty;
+
+	// Padded to a multiple of 4 fixtures
+	std::vector<float> m_Red;
+	std::vector<float> m_Green;
+	std::vector<float> m_Blue;
+	std::vector<float> m_Intensity;
+	std::vector<float> m_GainRed;
+	std::vector<float> m_GainGreen;
+	std::vector<float> m_GainBlue;
+	std::vector<float> m_DimmerMask;
+	std::vector<float> m_WhiteMask;
+	std::vector<float> m_AmberMask;
+	// Pass output: four channel values per fixture
+	std::vector<float> m_Channels;
+
+	std::atomic<uint32_t> m_FixtureCount;
+	std::atomic<uint32_t> m_PassMicros;
+
+	// Called with m_Mutex held
+	void Resize(uint32_t count);
+	// 'write' marks the fixture for the next pass
+	void UpdateProfile(uint32_t fixture, const ColorProfile& profile, bool write);
+	ColorProfile DefaultProfile(uint32_t fixture);
+	void Convert();
+public:
+	ColorPipeline(OutputScheduler* scheduler);
+
+	void SetProfile(uint32_t fixture, const ColorProfile& profile);
+	// Back to the default patch
+	void ResetProfile(uint32_t fixture);
+	ColorProfile GetProfile(uint32_t fixture);
+	// COLOR_MODE_RGB or COLOR_MODE_DRGB, for fixtures without a profile
+	void SetDefaultMode(uint8_t mode);
+
+	// rgbi: red, green, blue and intensity in 0..1
+	void SetColor(uint32_t fixture, const float* rgbi);
+	// Profiles stay as they are. Loading writes nothing but the changes that were
+	// still pending when the state was saved; fixtures it does not cover are cleared,
+	// so an empty state turns every fixture off without touching the universes.
+	void SaveColors(ColorState& state);
+	void LoadColors(const ColorState& state);
+
+	uint32_t GetFixtureCount() { return m_FixtureCount; }
+	uint32_t GetPassMicros() { return m_PassMicros; }
+
+	// Output thread, once per frame. Only does work after a change.
+	void RunFrame();
+
+	static size_t GetFootprint(const ColorProfile& profile);
+	// Level 0..1 through a response curve, 0..65535
+	static uint16_t Apply(uint8_t curve, float value);
+	// Per channel gains for a white point, the largest one is 1
+	static void TemperatureGains(float kelvin, float* gains);
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <OutputScheduler.h>
+#include <Result.h>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+
+#define CONTROL_OSC_DEFAULT_PORT 8000
+#define CONTROL_MIDI_DEFAULT_PORT 8001
+// Power of two, the queue indices wrap with a mask
+#define CONTROL_QUEUE_SIZE 1024
+#define CONTROL_NAME_LENGTH 32
+#define CONTROL_MAX_PACKET 2048
+#define CONTROL_OSC_MAX_DEPTH 4
+// MIDI clock pulses per quarter note
+#define CONTROL_MIDI_CLOCKS_PER_BEAT 24
+
+#define CONTROL_EVENT_CUE 0
+#define CONTROL_EVENT_SCENE 1
+#define CONTROL_EVENT_FADER 2
+#define CONTROL_EVENT_PARAMETER 3
+#define CONTROL_EVENT_BEAT 4
+
+// One control action. Plain data, so it is copied through the queue as is.
+struct ControlEvent
+{
+	uint8_t type;
+	// Scene number, fader channel (1-512) or parameter index
+	uint32_t index;
+	// Fader level or parameter value, 0..1
+	float value;
+	char name[CONTROL_NAME_LENGTH];
+	// Receive time on the steady clock, for the latency measurement
+	uint64_t receivedMicros;
+};
+
+// Single producer, single consumer ring of events: the input thread pushes, the
+// output thread pops. No locks and no allocation; a full queue drops the event.
+class ControlQueue
+{
+private:
+	ControlEvent m_Events[CONTROL_QUEUE_SIZE];
+	std::atomic<uint32_t> m_Head;
+	std::atomic<uint32_t> m_Tail;
+public:
+	ControlQueue();
+
+	bool Push(const ControlEvent& event);
+	bool Pop(ControlEvent& event);
+};
+
+// External control from one thread that listens on two UDP ports:
+//  - OSC: /cue/<name> (or /cue ,s), /scene/<number> (or /scene ,i), /fader/<channel> ,f 0..1
+//    (or ,i 0..255), /param/<index> the same way and /beat. Levels are clamped to 0..1.
+//    Bundles are unpacked. Buttons that send 0 on release only trigger on the press.
+//  - MIDI stand-in: raw MIDI bytes per datagram, e.g. from a MIDI-to-UDP bridge.
+//    Channel 1 note on = scene recall by note number, channel 1 CC = fader (CC + 1),
+//    channel 2 note on = cue named after the note number, channel 2 CC = parameter,
+//    clock (24 per beat) = beats.
+// Packets are parsed in place into ControlEvents and queued for the output thread,
+// which is asked for an early frame, see OutputScheduler::RequestFrame(). Latency is
+// measured from receiving a packet until the frame with its effect was handed to the
+// outputs.
+class ControlInput
+{
+private:
+	OutputScheduler* m_Scheduler;
+	std::atomic<bool> m_Running;
+	std::thread* m_Thread;
+	uintptr_t m_OscSocket;
+	uintptr_t m_MidiSocket;
+	ControlQueue m_Queue;
+
+	// Input thread: MIDI running status
+	uint8_t m_MidiStatus;
+	uint8_t m_MidiData[2];
+	uint8_t m_MidiCount;
+	uint32_t m_MidiClocks;
+
+	// Output thread: events applied in the current frame
+	uint64_t m_FrameOldest;
+	uint32_t m_FrameEvents;
+
+	std::atomic<uint64_t> m_Messages;
+	std::atomic<uint64_t> m_Invalid;
+	std::atomic<uint64_t> m_Dropped;
+	std::atomic<uint32_t> m_LatencyLast;
+	std::atomic<uint32_t> m_LatencyMax;
+	std::atomic<uint64_t> m_LatencyTotal;
+	std::atomic<uint64_t> m_LatencyFrames;
+	std::atomic<uint64_t> m_LatencyLate;
+
+	void Run();
+	void Post(ControlEvent& event);
+	void ParseOsc(const uint8_t* data, size_t size, uint64_t now, int depth);
+	bool ParseOscMessage(const uint8_t* data, size_t size, uint64_t now);
+	void ParseMidi(const uint8_t* data, size_t size, uint64_t now);
+	void HandleMidi(uint8_t status, const uint8_t* data, uint64_t now);
+public:
+	ControlInput(OutputScheduler* scheduler);
+	~ControlInput();
+
+	// A port of 0 disables that input. Without 'loopbackOnly' both listen on all interfaces.
+	Result Start(uint16_t oscPort, uint16_t midiPort, bool loopbackOnly);
+	void Stop();
+	bool IsRunning() { return m_Thread != nullptr; }
+
+	// Output thread: the next event to apply, false once the queue is empty
+	bool Poll(ControlEvent& event);
+	// Output thread, after the frame with the polled events went out
+	void FrameSent();
+	// Output thread: drops everything queued, without counting it as delivered
+	void Discard();
+
+	uint64_t GetMessageCount() { return m_Messages; }
+	uint64_t GetInvalidCount() { return m_Invalid; }
+	uint64_t GetDroppedCount() { return m_Dropped; }
+	uint32_t GetLatencyLastMicros() { return m_LatencyLast; }
+	uint32_t GetLatencyMaxMicros() { return m_LatencyMax; }
+	uint32_t GetLatencyAverageMicros() { uint64_t frames = m_LatencyFrames; return frames > 0 ? (uint32_t)(m_LatencyTotal / frames) : 0; }
+	// Frames whose oldest event waited longer than one frame period
+	uint64_t GetLateFrameCount() { return m_LatencyLate; }
+	void ResetLatency();
+};
@@ -4,9 +4,22 @@ extern "C" {
 #include <lauxlib.h>
 #include <lualib.h>
 }
+#include <Script.h>
+#include <Clock.h>
+#include <stdint.h>
+#include <vector>
 
 class DMXLuaLib
 {
 public:
 	static void LoadLib(lua_State* L);
+	// Only DMX_setChannel/DMX_setChannels, the functions that do not need the Application
+	static void LoadFrameLib(lua_State* L);
+	// Set by the ScriptEngine while it runs event handlers on the current thread
+	static void SetDispatching(bool dispatching);
+	static bool IsDispatching();
+	// The clock wait() sleeps on for the current thread, the real clock by default
+	static void SetClock(Clock* clock, int participant);
+	// Where DMX_setChannel writes on the current thread and which slots it may touch
+	static void SetFrameTarget(uint8_t* universes, const std::vector<ScriptClaim>* claims);
 };
\ No newline at end of file
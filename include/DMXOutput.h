@@ -0,0 +1,18 @@
+#pragma once
+#include <Result.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define DMX_UNIVERSE_SIZE 512
+// Upper bound for the universe state, universe sets are tracked as 64 bit masks
+#define DMX_MAX_UNIVERSES 64
+
+// A transport that receives the complete universe state once per output frame.
+// 'universes' holds 'universeCount' blocks of DMX_UNIVERSE_SIZE slots back to back.
+class DMXOutput
+{
+public:
+	virtual ~DMXOutput() {}
+
+	virtual Result SendFrame(const uint8_t* universes, size_t universeCount) = 0;
+};
\ No newline at end of file
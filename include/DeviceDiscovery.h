@@ -0,0 +1,66 @@
+#pragma once
+#include <SerialComm.h>
+#include <SerialOutput.h>
+#include <OutputScheduler.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#define CONN_STATUS_NOT_CONNECTED 0
+#define CONN_STATUS_CONNECTING 1
+#define CONN_STATUS_CONNECTED 2
+
+#define DISCOVERY_POLL_MS 250
+#define DISCOVERY_BACKOFF_MIN_MS 50
+#define DISCOVERY_BACKOFF_MAX_MS 400
+#define SERIAL_BAUD_RATE 115200
+
+// Enumerates Arduino serial ports and owns the connection on its own thread.
+// The UI only posts Connect()/Disconnect() requests and reads the status, so it
+// never blocks on port I/O. A pulled cable (port gone or a failed write) puts the
+// connection back into CONN_STATUS_CONNECTING and it is reopened with backoff;
+// 'onConnected' runs on every (re)connect so the device state can be replayed.
+class DeviceDiscovery
+{
+private:
+	SerialComm* m_Comm;
+	SerialOutput* m_Output;
+	OutputScheduler* m_Scheduler;
+	std::function<void()> m_OnConnected;
+
+	std::thread* m_Thread;
+	std::atomic<bool> m_Running;
+	std::atomic<int> m_Status;
+	std::atomic<uint32_t> m_PortsVersion;
+	std::atomic<uint32_t> m_ReconnectCount;
+
+	std::mutex m_Mutex;
+	std::vector<std::string> m_Ports;
+	std::string m_WantedPort;
+	bool m_WantConnection;
+
+	void Run();
+	bool OpenPort(const std::string& port);
+	void ClosePort();
+public:
+	DeviceDiscovery(SerialComm* comm, SerialOutput* output, OutputScheduler* scheduler);
+	~DeviceDiscovery();
+
+	void Start(std::function<void()> onConnected);
+	void Stop();
+
+	void Connect(const std::string& port);
+	void Disconnect();
+
+	int GetStatus() { return m_Status; }
+	uint32_t GetReconnectCount() { return m_ReconnectCount; }
+	// Bumped whenever the port list changes, so callers only copy it when needed
+	uint32_t GetPortsVersion() { return m_PortsVersion; }
+	std::vector<std::string> GetPorts();
+
+	static std::vector<std::string> EnumeratePorts();
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include <Result.h>
+#include <DMXOutput.h>
+#include <DMXFrameDecoder.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+// Encodings the encoder may pick from, CODEC_MODE_ADAPTIVE takes the smallest per frame
+#define CODEC_MODE_ADAPTIVE 0
+#define CODEC_MODE_KEY 1
+#define CODEC_MODE_BITMAP 2
+#define CODEC_MODE_RLE 3
+#define CODEC_MODE_COUNT 4
+
+#define CODEC_DEFAULT_KEY_INTERVAL 40
+// Unchanged slots shorter than this stay inside an RLE run, a new token costs 2 bytes
+#define CODEC_RLE_MIN_GAP 3
+
+// Encodes one universe per output frame into the wire format described in
+// DMXFrameDecoder.h. Frames without changes are not sent at all; every
+// keyInterval frames a keyframe goes out regardless, so a decoder that lost
+// sync recovers within that many frames. Encode() runs on the output thread,
+// the setters may be called from anywhere and apply at the next frame.
+class FrameEncoder
+{
+private:
+	std::vector<uint8_t> m_Previous;
+	std::string m_Payloads[DMX_FRAME_TYPES];
+	uint8_t m_Sequence;
+	uint32_t m_SinceKey;
+	size_t m_LastSlotCount;
+
+	std::atomic<uint32_t> m_SlotCount;
+	std::atomic<uint32_t> m_KeyInterval;
+	std::atomic<int> m_Mode;
+	std::atomic<bool> m_ForceKey;
+
+	std::atomic<uint64_t> m_Frames[DMX_FRAME_TYPES];
+	std::atomic<uint64_t> m_Unchanged;
+	std::atomic<uint64_t> m_Bytes;
+public:
+	FrameEncoder();
+
+	void SetSlotCount(uint32_t count);
+	uint32_t GetSlotCount() { return m_SlotCount; }
+	void SetKeyInterval(uint32_t frames) { m_KeyInterval = frames > 0 ? frames : 1; }
+	void SetMode(int mode) { m_Mode = mode; }
+	// The next frame is a keyframe, e.g. after the port was reopened
+	void ForceKeyframe() { m_ForceKey = true; }
+
+	// Appends the encoded frame to 'out'. Returns the frame type, or -1 when nothing was sent.
+	int Encode(const uint8_t* slots, std::string& out);
+
+	uint64_t GetFrameCount(int type) { return type >= 0 && type < DMX_FRAME_TYPES ? (uint64_t)m_Frames[type] : 0; }
+	uint64_t GetUnchangedCount() { return m_Unchanged; }
+	uint64_t GetByteCount() { return m_Bytes; }
+	void ResetStats();
+
+	static void EncodeKey(const uint8_t* slots, size_t count, std::string& payload);
+	static void EncodeBitmap(const uint8_t* slots, const uint8_t* previous, size_t count, std::string& payload);
+	static void EncodeRle(const uint8_t* slots, const uint8_t* previous, size_t count, std::string& payload);
+	static void AppendFrame(int type, uint8_t sequence, const std::string& payload, std::string& out);
+};
+
+struct CodecBenchmark
+{
+	uint64_t frames;
+	uint64_t sentFrames;
+	uint64_t bytes;
+	// Frames per second the line could carry at this size, for the given baud rate
+	double framesPerSecond;
+	double encodeMicros;
+	// The reference decoder reproduced every frame
+	bool verified;
+};
+
+// Runs every encoding over universe 0 of a capture file (see RecordingOutput) and
+// decodes the result with the reference decoder.
+Result BenchmarkCapture(const std::string& path, uint32_t slotCount, uint32_t keyInterval, uint32_t baudRate, CodecBenchmark results[CODEC_MODE_COUNT]);
@@ -0,0 +1,69 @@
+#pragma once
+#include <Result.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SEQUENCE_FILE_MAGIC 0x58504653 // "SFPX"
+#define SEQUENCE_FILE_VERSION 1
+// Size of the mapped window, frames are streamed through it instead of mapping the whole file
+#define SEQUENCE_WINDOW_SIZE (32 * 1024 * 1024)
+
+struct SequenceFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frameCount;
+	float frameRate;
+};
+
+// A read-only sequence of RGB24 frames (row-major, top row first) in one file:
+// either a .sfpx file (SequenceFileHeader followed by the frames) or a headerless
+// raw dump such as "ffmpeg -f rawvideo -pix_fmt rgb24". Only a window of the file
+// is mapped at a time and moved along as playback advances, so sequences larger
+// than the address space play fine. Not thread-safe, the PixelMapper serializes access.
+class FrameSequence
+{
+private:
+	// Win32 HANDLEs, the header stays free of windows.h
+	void* m_File;
+	void* m_Mapping;
+	uint8_t* m_View;
+	uint64_t m_ViewOffset;
+	size_t m_ViewSize;
+	uint64_t m_FileSize;
+	uint64_t m_DataOffset;
+	size_t m_FrameSize;
+	uint32_t m_Width;
+	uint32_t m_Height;
+	uint32_t m_FrameCount;
+	float m_FrameRate;
+
+	Result OpenFile(const std::string& path);
+	Result MapWindow(uint64_t offset, size_t size);
+public:
+	FrameSequence();
+	~FrameSequence();
+
+	Result Open(const std::string& path);
+	Result OpenRaw(const std::string& path, uint32_t width, uint32_t height, float frameRate);
+	void Close();
+	bool IsOpen() { return m_Mapping != nullptr; }
+
+	// Points into the mapping, valid until the next GetFrame()/Close()
+	const uint8_t* GetFrame(uint32_t index);
+	// Asks the OS to page in a frame ahead of time if it lies in the current window
+	void Prefetch(uint32_t index);
+
+	uint32_t GetWidth() { return m_Width; }
+	uint32_t GetHeight() { return m_Height; }
+	uint32_t GetFrameCount() { return m_FrameCount; }
+	float GetFrameRate() { return m_FrameRate; }
+
+	// Decodes a PNG (or any other format WIC knows) to RGB24. COM must be initialized on the calling thread.
+	static Result DecodeImage(const std::string& path, uint32_t* width, uint32_t* height, std::vector<uint8_t>& rgb);
+	// Decodes the images in order and writes them as a .sfpx file. All images must have the same size.
+	static Result Import(const std::vector<std::string>& images, const std::string& path, float frameRate);
+};
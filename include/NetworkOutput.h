@@ -0,0 +1,63 @@
+#pragma once
+#include <DMXOutput.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#define NET_PROTOCOL_ARTNET 0
+#define NET_PROTOCOL_SACN 1
+
+#define ARTNET_PORT 6454
+#define ARTNET_HEADER_SIZE 18
+#define ARTNET_OPCODE_DMX 0x5000
+#define ARTNET_PROTOCOL_VERSION 14
+
+#define SACN_PORT 5568
+#define SACN_HEADER_SIZE 126
+#define SACN_DEFAULT_PRIORITY 100
+#define SACN_SOURCE_NAME "SFST DMX Controller"
+
+#define NET_MAX_UNIVERSES DMX_MAX_UNIVERSES
+
+// Sends every universe as an Art-Net ArtDmx or sACN (E1.31) data packet per frame.
+// All packets are built once in Open(); a frame only patches sequence numbers and slot data.
+class NetworkOutput : public DMXOutput
+{
+private:
+	bool m_Open;
+	uintptr_t m_Socket;
+	int m_Protocol;
+	uint16_t m_Port;
+	uint16_t m_FirstUniverse;
+	size_t m_UniverseCount;
+	size_t m_PacketSize;
+	std::vector<uint8_t> m_Packets;
+	std::vector<uint32_t> m_Destinations;
+	uint8_t m_Sequence;
+	std::atomic<uint64_t> m_PacketsSent;
+	std::atomic<uint64_t> m_SendErrors;
+
+	void BuildArtNetHeader(uint8_t* packet, uint16_t universe);
+	void BuildSACNHeader(uint8_t* packet, uint16_t universe, const uint8_t* cid);
+public:
+	NetworkOutput();
+	~NetworkOutput();
+
+	// An empty host sends Art-Net as broadcast and sACN to the per-universe multicast group
+	Result Open(int protocol, const std::string& host, size_t universeCount, uint16_t firstUniverse);
+	Result Close();
+	bool IsOpen() { return m_Open; }
+
+	Result SendFrame(const uint8_t* universes, size_t universeCount) override;
+
+	uint64_t GetPacketsSent() { return m_PacketsSent; }
+	uint64_t GetSendErrors() { return m_SendErrors; }
+
+	// WSAStartup/WSACleanup, once per process around all network use
+	static Result InitNetwork();
+	static void ShutdownNetwork();
+
+	static uint16_t GetPort(int protocol) { return protocol == NET_PROTOCOL_SACN ? SACN_PORT : ARTNET_PORT; }
+	static size_t GetHeaderSize(int protocol) { return protocol == NET_PROTOCOL_SACN ? SACN_HEADER_SIZE : ARTNET_HEADER_SIZE; }
+};
\ No newline at end of file
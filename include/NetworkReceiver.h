@@ -0,0 +1,40 @@
+#pragma once
+#include <NetworkOutput.h>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+
+// Loopback receiver for testing NetworkOutput without a real node: listens on
+// 127.0.0.1, checks every packet against the protocol layout and counts
+// packets, malformed packets and sequence gaps per universe.
+class NetworkReceiver
+{
+private:
+	std::atomic<bool> m_Running;
+	std::thread* m_Thread;
+	uintptr_t m_Socket;
+	int m_Protocol;
+	std::atomic<uint64_t> m_Packets;
+	std::atomic<uint64_t> m_Bytes;
+	std::atomic<uint64_t> m_Invalid;
+	std::atomic<uint64_t> m_SequenceErrors;
+	uint8_t m_LastSequence[NET_MAX_UNIVERSES];
+	bool m_SeenUniverse[NET_MAX_UNIVERSES];
+
+	void Run();
+public:
+	NetworkReceiver();
+	~NetworkReceiver();
+
+	Result Start(int protocol);
+	void Stop();
+	bool IsRunning() { return m_Thread != nullptr; }
+
+	uint64_t GetPacketCount() { return m_Packets; }
+	uint64_t GetByteCount() { return m_Bytes; }
+	uint64_t GetInvalidCount() { return m_Invalid; }
+	uint64_t GetSequenceErrorCount() { return m_SequenceErrors; }
+
+	// Returns false if the packet is not a well formed DMX data packet of the given protocol
+	static bool Validate(int protocol, const uint8_t* packet, size_t size, uint16_t* universe, uint8_t* sequence);
+};
\ No newline at end of file
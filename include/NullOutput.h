@@ -0,0 +1,22 @@
+#pragma once
+#include <DMXOutput.h>
+#include <stdint.h>
+#include <atomic>
+
+// Discards frames but counts them and keeps a running FNV-1a hash over their
+// content, so two simulation runs can be compared without recording them.
+class NullOutput : public DMXOutput
+{
+private:
+	std::atomic<uint64_t> m_FrameCount;
+	std::atomic<uint64_t> m_Checksum;
+public:
+	NullOutput();
+
+	// Only while not attached to a scheduler
+	void Reset();
+	uint64_t GetFrameCount() { return m_FrameCount; }
+	uint64_t GetChecksum() { return m_Checksum; }
+
+	Result SendFrame(const uint8_t* universes, size_t universeCount) override;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <DMXOutput.h>
+#include <Clock.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#define OUTPUT_DEFAULT_FPS 40
+#define OUTPUT_ALL_UNIVERSES 0xFFFFFFFFFFFFFFFFull
+#define OUTPUT_BUFFER_COUNT 3
+// A requested frame comes at the earliest this fraction of a period after the previous one
+#define OUTPUT_EARLY_FRAME_DIVISOR 2
+
+// Owns the universe state and hands a consistent copy of it to every registered
+// output at a fixed frame rate from its own thread.
+//
+// Writers (UI, script threads, the frame callback) serialize on m_WriteMutex and
+// change m_Working. Every finished write publishes through a triple buffer: the
+// changed universes are copied into the writers' back buffer, which is then
+// swapped into m_Ready. The output thread swaps m_Ready with its front buffer when
+// it is marked fresh. Neither side ever waits for the other, and the front buffer
+// is read in place without another copy.
+//
+// Frames are paced by a Clock. On a VirtualClock the scheduler does not sleep at
+// all, each frame advances the simulated time by one frame period. RequestFrame()
+// pulls the next frame forward (to at least half a period after the last one), so
+// external input is on the wire in less than a frame; simulated time keeps its
+// fixed cadence.
+class OutputScheduler
+{
+private:
+	std::vector<uint8_t> m_Working;
+	std::vector<uint8_t> m_Buffers[OUTPUT_BUFFER_COUNT];
+	size_t m_BufferCounts[OUTPUT_BUFFER_COUNT];
+	// Universes changed since each buffer was last the back buffer (writers only)
+	uint64_t m_BufferDirty[OUTPUT_BUFFER_COUNT];
+	size_t m_BackIndex;
+	size_t m_FrontIndex;
+	// Index of the ready buffer, OUTPUT_READY_FRESH set when it was published after the last swap
+	std::atomic<uint32_t> m_Ready;
+	std::atomic<size_t> m_UniverseCount;
+	std::mutex m_WriteMutex;
+
+	std::vector<DMXOutput*> m_Outputs;
+	std::function<void(double)> m_FrameCallback;
+	std::function<void()> m_FrameSentCallback;
+	std::function<void()> m_LimitCallback;
+	std::atomic<bool> m_FrameRequested;
+	std::mutex m_OutputMutex;
+	std::thread* m_Thread;
+	std::atomic<bool> m_Running;
+	std::atomic<uint64_t> m_FrameCount;
+	std::atomic<uint64_t> m_LastFrameMicros;
+	uint32_t m_FrameRate;
+	uint64_t m_FrameLimit;
+	// Atomic for RequestFrame(), which may race a restart on another clock
+	std::atomic<Clock*> m_Clock;
+	std::atomic<int> m_ClockParticipant;
+
+	// Called with m_WriteMutex held
+	void Publish(uint64_t dirtyUniverses);
+	void Run();
+public:
+	OutputScheduler(Clock* clock);
+	~OutputScheduler();
+
+	// With a frame limit the thread ends by itself after that many frames, IsRunning() turns false then
+	void Start(uint32_t frameRate, uint64_t frameLimit = 0);
+	void Stop();
+	bool IsRunning() { return m_Running; }
+	// Only while stopped
+	void SetClock(Clock* clock);
+	Clock* GetClock() { return m_Clock; }
+	// Runs on the output thread at the start of every frame with the seconds since the
+	// previous one, before the universe snapshot is taken. Set it before Start().
+	void SetFrameCallback(std::function<void(double)> callback) { m_FrameCallback = callback; }
+	// Runs on the output thread once every output has been handed the frame. Set it before Start().
+	void SetFrameSentCallback(std::function<void()> callback) { m_FrameSentCallback = callback; }
+	// Runs on the output thread when the frame limit ends the run, before it leaves the
+	// clock, so nothing else on a virtual clock moves past the last frame first. Set it before Start().
+	void SetLimitCallback(std::function<void()> callback) { m_LimitCallback = callback; }
+	// Any thread: run the next frame as soon as the minimum gap allows. Ignored on a simulated clock.
+	void RequestFrame();
+
+	// Clamped to 1..DMX_MAX_UNIVERSES
+	void SetUniverseCount(size_t count);
+	size_t GetUniverseCount() { return m_UniverseCount; }
+	void SetChannels(size_t universe, size_t start, const uint8_t* values, size_t count);
+	void GetChannels(size_t universe, size_t start, uint8_t* values, size_t count);
+	// Direct access for bulk writers (scene recall, crossfades). Holds the write lock
+	// until EndWrite(), which publishes the universes in the mask (0 for read-only use).
+	uint8_t* BeginWrite(size_t* universeCount);
+	void EndWrite(uint64_t dirtyUniverses = OUTPUT_ALL_UNIVERSES);
+
+	void AddOutput(DMXOutput* output);
+	void RemoveOutput(DMXOutput* output);
+
+	uint32_t GetFrameRate() { return m_FrameRate; }
+	uint64_t GetFrameCount() { return m_FrameCount; }
+	// Clock time the last frame started at
+	uint64_t GetLastFrameMicros() { return m_LastFrameMicros; }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <OutputScheduler.h>
+#include <FrameSequence.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Slots per mapped fixture, same values as DMX_RGB/DMX_DRGB
+#define PIXEL_LAYOUT_RGB 3
+#define PIXEL_LAYOUT_DRGB 4
+#define PIXEL_MAX_FIXTURES 8192
+#define PIXEL_DEFAULT_GAMMA 2.2f
+
+// Where a fixture sits in the frame and which slots it drives
+struct PixelFixture
+{
+	// 0..1 across the frame, (0, 0) is the top left pixel center, (1, 1) the bottom right one
+	float x;
+	float y;
+	uint16_t universe;
+	// 0-based first slot
+	uint16_t start;
+	uint8_t channels;
+};
+
+// Bilinear sample position of a fixture, precomputed for one frame size
+struct PixelSample
+{
+	uint32_t offsets[4];
+	float weights[4];
+};
+
+// Maps frames of a FrameSequence onto fixture positions. Runs on the output thread
+// right after the script handlers: samples every fixture bilinearly, applies gamma
+// and brightness to all fixtures in one SSE2 pass and writes the slots straight into
+// the scheduler's universes. Layout and sequence changes come from the UI thread.
+class PixelMapper
+{
+private:
+	OutputScheduler* m_Scheduler;
+
+	std::mutex m_Mutex;
+	std::vector<PixelFixture> m_Fixtures;
+	std::vector<PixelSample> m_Samples;
+	uint32_t m_SampleWidth;
+	uint32_t m_SampleHeight;
+	// 4 values (R G B unused) per fixture
+	std::vector<float> m_Colors;
+	std::vector<uint8_t> m_Values;
+	FrameSequence m_Sequence;
+	double m_Position;
+
+	std::atomic<bool> m_Playing;
+	std::atomic<bool> m_Loop;
+	std::atomic<float> m_Gamma;
+	std::atomic<float> m_Brightness;
+	std::atomic<uint32_t> m_FrameIndex;
+	std::atomic<uint32_t> m_FrameCount;
+	std::atomic<uint32_t> m_RenderMicros;
+
+	// Called with m_Mutex held
+	void BuildSamples(uint32_t width, uint32_t height);
+	void Sample(const uint8_t* frame);
+public:
+	PixelMapper(OutputScheduler* scheduler);
+
+	void SetFixtures(const std::vector<PixelFixture>& fixtures);
+	size_t GetFixtureCount();
+	// columns x rows fixtures filling the frame, row by row from the top left. Fixtures
+	// continue in the next universe when they would cross slot 512. 'serpentine'
+	// reverses every second row, the usual wiring of LED matrices.
+	static std::vector<PixelFixture> LayoutGrid(uint32_t columns, uint32_t rows, uint16_t universe, uint16_t start, uint8_t channels, bool serpentine);
+	// One fixture per line: "x y universe channel [channels]", channel 1-512, '#' starts a comment
+	static Result LoadLayout(const std::string& path, std::vector<PixelFixture>& fixtures);
+
+	Result OpenSequence(const std::string& path);
+	Result OpenRawSequence(const std::string& path, uint32_t width, uint32_t height, float frameRate);
+	void CloseSequence();
+
+	void Play() { m_Playing = true; }
+	void Stop() { m_Playing = false; }
+	bool IsPlaying() { return m_Playing; }
+	void SetLoop(bool loop) { m_Loop = loop; }
+	void Rewind();
+	// Position in frames of the open sequence
+	double GetPosition();
+	void SetPosition(double position);
+	void SetGamma(float gamma) { m_Gamma = gamma; }
+	void SetBrightness(float brightness) { m_Brightness = brightness; }
+
+	uint32_t GetFrameIndex() { return m_FrameIndex; }
+	uint32_t GetFrameCount() { return m_FrameCount; }
+	uint32_t GetRenderMicros() { return m_RenderMicros; }
+
+	// Output thread, once per frame
+	void RunFrame(double dt);
+
+	// values: 'count' floats in 0..255, count a multiple of 4. out = 255 * brightness * (v / 255)^gamma
+	static void Correct(const float* values, size_t count, float gamma, float brightness, uint8_t* out);
+};
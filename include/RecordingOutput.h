@@ -0,0 +1,45 @@
+#pragma once
+#include <DMXOutput.h>
+#include <Result.h>
+#include <stdint.h>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+#define CAPTURE_FILE_MAGIC 0x50434653 // "SFCP"
+#define CAPTURE_FILE_VERSION 1
+
+// A capture is this header followed by universeCount * DMX_UNIVERSE_SIZE slots per frame
+struct CaptureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t universeCount;
+	uint32_t frameRate;
+};
+
+// Writes every output frame to a capture file, e.g. to record a show for the
+// serial compression benchmark. Universes beyond the capture's count are dropped,
+// missing ones are written as zeros.
+class RecordingOutput : public DMXOutput
+{
+private:
+	std::mutex m_Mutex;
+	// Win32 HANDLE, the header stays free of windows.h
+	void* m_File;
+	uint32_t m_UniverseCount;
+	std::atomic<uint64_t> m_FrameCount;
+	std::atomic<bool> m_Failed;
+public:
+	RecordingOutput();
+	~RecordingOutput();
+
+	Result Open(const std::string& path, uint32_t universeCount, uint32_t frameRate);
+	Result Close();
+	bool IsOpen();
+	uint64_t GetFrameCount() { return m_FrameCount; }
+	// Set once a write fails, the capture is closed then
+	bool HasFailed() { return m_Failed; }
+
+	Result SendFrame(const uint8_t* universes, size_t universeCount) override;
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+typedef unsigned char Result;
+
+#define RESULT_SUCCESS 0
+#define RESULT_ERROR 1
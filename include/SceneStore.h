@@ -0,0 +1,105 @@
+#pragma once
+#include <Result.h>
+#include <DMXOutput.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#define SCENE_FILE_MAGIC 0x43534653 // "SFSC"
+#define SCENE_FILE_VERSION 1
+#define SCENE_INITIAL_CAPACITY 256
+#define SCENE_NAME_LENGTH 32
+#define SCENE_NOT_FOUND 0xFFFFFFFF
+
+// Control settings stored next to the universe data of a scene
+struct SceneSettings
+{
+	uint8_t syncMode;
+	uint8_t smoothing;
+	uint8_t dmxEnabled;
+	uint8_t dmxChannels;
+	float smoothingSpeed;
+	int32_t targetId;
+	float color[4];
+};
+
+struct SceneFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t universeCount;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t recordSize;
+};
+
+// Fixed size record, followed directly by universeCount * DMX_UNIVERSE_SIZE slots
+struct SceneRecord
+{
+	char name[SCENE_NAME_LENGTH];
+	uint32_t number;
+	// Universes the scene was saved with, 0 (older files) means all of the file
+	uint32_t universeCount;
+	SceneSettings settings;
+};
+
+// Scenes live in one memory-mapped file of fixed-size records. Name and number
+// indices are rebuilt once in Open(), after that lookups are hash lookups and a
+// recall is a single memcpy out of the mapping. Names are unique, empty names are
+// not indexed. Saving more universes than the records hold re-lays out the file,
+// older scenes keep their own universe count. Used from the UI thread, except
+// for Recall(), which may run on any thread; m_Mutex keeps the mapping and the
+// number index stable while it copies.
+class SceneStore
+{
+private:
+	// Win32 HANDLEs, the header stays free of windows.h
+	void* m_File;
+	void* m_Mapping;
+	uint8_t* m_View;
+	size_t m_ViewSize;
+	size_t m_UniverseCount;
+	size_t m_RecordSize;
+	std::unordered_map<uint32_t, uint32_t> m_ByNumber;
+	std::unordered_map<std::string, uint32_t> m_ByName;
+	std::mutex m_Mutex;
+
+	SceneFileHeader* Header() { return (SceneFileHeader*)m_View; }
+	SceneRecord* Record(uint32_t index) { return (SceneRecord*)(m_View + sizeof(SceneFileHeader) + (size_t)index * m_RecordSize); }
+	Result Map(size_t size);
+	void Unmap();
+	Result Grow();
+	Result Relayout(size_t universeCount);
+	size_t RecordUniverses(const SceneRecord* record) { return record->universeCount > 0 && record->universeCount < m_UniverseCount ? record->universeCount : m_UniverseCount; }
+	// Called with m_Mutex held
+	void Release();
+public:
+	SceneStore();
+	~SceneStore();
+
+	// Opens or creates the file. universeCount is only used for a new file, it grows with Save().
+	Result Open(const std::string& path, size_t universeCount);
+	void Close();
+	bool IsOpen() { return m_View != nullptr; }
+
+	// Fails when another scene already has this name
+	Result Save(const std::string& name, uint32_t number, const uint8_t* universes, size_t universeCount, const SceneSettings& settings);
+
+	uint32_t FindByNumber(uint32_t number);
+	uint32_t FindByName(const std::string& name);
+	uint32_t GetCount() { return IsOpen() ? Header()->count : 0; }
+	size_t GetUniverseCount() { return m_UniverseCount; }
+	// Universes stored for one scene, 0 for an unknown index
+	size_t GetSceneUniverseCount(uint32_t index);
+
+	const SceneRecord* GetRecord(uint32_t index);
+	const uint8_t* GetUniverses(uint32_t index);
+
+	// Copies the universes of the scene with this number into 'out', any thread. Returns its index or SCENE_NOT_FOUND.
+	uint32_t Recall(uint32_t number, uint8_t* out, size_t universeCount);
+
+	// Writes the mix of two scenes straight from the mapping into 'out', t in [0, 1]. Universes
+	// one of the scenes was saved without are left untouched, like Recall() does.
+	void Crossfade(uint32_t from, uint32_t to, float t, uint8_t* out, size_t universeCount);
+};
\ No newline at end of file
@@ -5,14 +5,51 @@ extern "C" {
 #include <lualib.h>
 }
 #include <string>
+#include <vector>
+#include <stdint.h>
 
+#define SCRIPT_EVENT_FRAME 0
+#define SCRIPT_EVENT_BEAT 1
+#define SCRIPT_EVENT_CUE 2
+#define SCRIPT_EVENT_COUNT 3
+
+// Slots a script writes with DMX_setChannel, declared with DMX_claim in the script body
+struct ScriptClaim
+{
+	uint16_t universe;
+	uint16_t start;
+	uint16_t count;
+};
 
 class Script
 {
 private:
 	lua_State* L;
 	int error;
+	// Registry references of the onFrame/onBeat/onCue handlers, LUA_NOREF if unset
+	int m_Handlers[SCRIPT_EVENT_COUNT];
+	std::vector<ScriptClaim> m_Claims;
+	std::string m_Error;
+
+	void Call(int event, int args);
 public:
-	Script(const std::string& path);
+	// 'instance' is exposed to the script as the global scriptInstance. Runs the
+	// script body, a loop-style script only returns from here when it is done.
+	Script(const std::string& path, int instance = 0);
 	~Script();
+
+	// Message of the error that ended the script body, empty if it ran through
+	const std::string& GetError() { return m_Error; }
+
+	void SetHandler(int event, int ref);
+	bool HasHandlers();
+
+	void Claim(uint16_t universe, uint16_t start, uint16_t count);
+	const std::vector<ScriptClaim>& GetClaims() { return m_Claims; }
+	size_t GetClaimedSlots();
+
+	// Only called from the output tick, after the script body has returned
+	void OnFrame(double dt);
+	void OnBeat(int n);
+	void OnCue(const char* name);
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <Script.h>
+#include <OutputScheduler.h>
+#include <NetworkOutput.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define SCRIPT_MAX_UNIVERSES NET_MAX_UNIVERSES
+#define SCRIPT_MAX_WORKERS 16
+// Numbered values scripts read with getParameter(), set from external control
+#define SCRIPT_MAX_PARAMETERS 128
+// Cues delivered per frame, more are dropped
+#define SCRIPT_MAX_CUES 64
+#define SCRIPT_CUE_NAME_LENGTH 32
+
+// One worker thread and the scripts (lua_States) it owns. Scripts render into
+// the worker's private universe buffer, nobody else touches it during a frame.
+struct ScriptWorker
+{
+	std::thread* thread;
+	std::vector<Script*> scripts;
+	std::vector<uint8_t> buffer;
+};
+
+// Runs the onFrame/onBeat/onCue handlers of all loaded scripts from the output
+// tick. Scripts whose DMX_claim ranges overlap share a worker, everything else is
+// spread over a pool of workers by claimed slot count. Each frame all workers
+// render in parallel, a barrier waits for the slowest one, then the claimed
+// ranges are merged into the scheduler's universes. Scripts without claims (the
+// DMX_setColor kind) all run on worker 0, since they share the serial color state.
+// Beats and cues posted from other threads are delivered at the next frame.
+// The output thread itself (the frame callback before RunFrame) adds them with
+// FrameBeat()/FrameCue(), which take no lock and do not allocate.
+class ScriptEngine
+{
+private:
+	OutputScheduler* m_Scheduler;
+
+	std::mutex m_Mutex;
+	std::vector<Script*> m_Scripts;
+	std::vector<ScriptWorker*> m_Workers;
+	size_t m_WorkerCount;
+
+	std::mutex m_FrameMutex;
+	std::condition_variable m_StartCondition;
+	std::condition_variable m_DoneCondition;
+	uint64_t m_Generation;
+	size_t m_Remaining;
+	bool m_Stopping;
+	double m_FrameDelta;
+	int m_FrameFirstBeat;
+	int m_FrameBeats;
+
+	std::mutex m_EventMutex;
+	int m_PendingBeats;
+	std::vector<std::string> m_PendingCues;
+
+	// Output thread: cues and beats of the next frame
+	char m_Cues[SCRIPT_MAX_CUES][SCRIPT_CUE_NAME_LENGTH];
+	size_t m_CueCount;
+	int m_OwnBeats;
+
+	std::atomic<float> m_BeatsPerMinute;
+	std::atomic<float> m_Parameters[SCRIPT_MAX_PARAMETERS];
+	std::atomic<uint32_t> m_FrameMicros;
+	std::atomic<uint32_t> m_WorkerMicros[SCRIPT_MAX_WORKERS];
+	std::atomic<uint32_t> m_WorkerScripts[SCRIPT_MAX_WORKERS];
+	double m_BeatPhase;
+	int m_BeatCount;
+
+	void StartWorkers(size_t count);
+	void StopWorkers();
+	void RunWorker(size_t index, uint64_t generation);
+	void RenderWorker(size_t index);
+	void Reassign();
+public:
+	ScriptEngine(OutputScheduler* scheduler);
+	~ScriptEngine();
+
+	// The engine owns added scripts and deletes them in Remove()/Clear()
+	void Add(Script* script);
+	// Waits for a running frame, after this the script is no longer touched
+	void Remove(Script* script);
+	void Clear();
+	size_t GetScriptCount();
+
+	void Beat();
+	void Cue(const std::string& name);
+	// Output thread only, before RunFrame(). Returns false when the frame has no cue slot left.
+	void FrameBeat() { m_OwnBeats++; }
+	bool FrameCue(const char* name);
+	// Beat count, beat clock phase and undelivered events back to the start, only while the scheduler is stopped
+	void ResetBeats();
+	// 0 disables the internal beat clock
+	void SetBeatsPerMinute(float bpm) { m_BeatsPerMinute = bpm; }
+	void SetParameter(size_t index, float value) { if (index < SCRIPT_MAX_PARAMETERS) m_Parameters[index] = value; }
+	float GetParameter(size_t index) { return index < SCRIPT_MAX_PARAMETERS ? (float)m_Parameters[index] : 0.0f; }
+
+	// 0 picks one worker per hardware thread, minus one for the other threads
+	void SetWorkerCount(size_t count);
+	size_t GetWorkerCount() { return m_WorkerCount; }
+	uint32_t GetWorkerMicros(size_t index) { return index < SCRIPT_MAX_WORKERS ? (uint32_t)m_WorkerMicros[index] : 0; }
+	uint32_t GetWorkerScriptCount(size_t index) { return index < SCRIPT_MAX_WORKERS ? (uint32_t)m_WorkerScripts[index] : 0; }
+	// Wall time of the last RunFrame including the merge
+	uint32_t GetFrameMicros() { return m_FrameMicros; }
+
+	void RunFrame(double dt);
+};
\ No newline at end of file
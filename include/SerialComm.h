@@ -1,13 +1,9 @@
 #pragma once
 #include <windows.h>
+#include <Result.h>
 #include <stdint.h>
 #include <string>
 
-typedef unsigned char Result;
-
-#define RESULT_SUCCESS 0
-#define RESULT_ERROR 1
-
 class SerialComm
 {
 private:
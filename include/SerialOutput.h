@@ -0,0 +1,40 @@
+#pragma once
+#include <DMXOutput.h>
+#include <SerialComm.h>
+#include <FrameCodec.h>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+// Sends the Arduino messages ("\x01cmd:value;" and "\x01r:g:b:d;") on the output tick.
+// Messages keep their order; consecutive color messages collapse into the latest one.
+// With compression on, universe 0 follows the messages as a compressed frame (see FrameCodec.h).
+class SerialOutput : public DMXOutput
+{
+private:
+	SerialComm* m_Comm;
+	std::mutex m_Mutex;
+	std::string m_Pending;
+	std::string m_Sending;
+	std::string m_LastColor;
+	size_t m_ColorOffset;
+	std::atomic<bool> m_Failed;
+	FrameEncoder m_Encoder;
+	std::atomic<bool> m_Compress;
+public:
+	SerialOutput(SerialComm* comm);
+
+	void QueueMessage(const std::string& message);
+	void QueueColor(const std::string& message);
+	void Clear();
+	// Queues the most recent color again, e.g. after the port was reopened
+	void ReplayColor();
+	// Set once a write to the port fails, cleared by Clear()
+	bool HasFailed() { return m_Failed; }
+
+	void SetCompression(bool enabled);
+	bool IsCompressing() { return m_Compress; }
+	FrameEncoder& GetEncoder() { return m_Encoder; }
+
+	Result SendFrame(const uint8_t* universes, size_t universeCount) override;
+};
\ No newline at end of file
@@ -0,0 +1,25 @@
+-- Mehrmals starten: jede Instanz rendert einen eigenen Block von 64 Kanaelen, acht
+-- Instanzen teilen sich ein Universum, die Bereiche ueberlappen also auch mit nur
+-- einem Universum nicht und landen auf verschiedenen Workern. Die Worker-Zeiten
+-- stehen unter "Skript-Worker", mit dem Worker-Regler vergleichen (1 vs. alle Kerne).
+-- Ohne App: tests/ScriptEngineBenchmark.cpp
+local BLOCK = 64
+local blocks = 512 / BLOCK
+local universe = math.floor(scriptInstance / blocks) % DMX_getUniverses()
+local channel = (scriptInstance % blocks) * BLOCK + 1
+local time = 0
+local values = {}
+
+DMX_claim(universe, channel, BLOCK)
+
+onFrame(function(dt)
+	time = time + dt
+	for i = 1, BLOCK do
+		local v = 0
+		for k = 1, 400 do
+			v = v + math.sin(time * k + (channel + i) * 0.05) * math.cos(time * 0.5 + k)
+		end
+		values[i] = math.floor((v / 400 + 1) * 127.5)
+	end
+	DMX_setChannels(universe, channel, values)
+end)
@@ -0,0 +1,21 @@
+local brightness = 255
+
+onBeat(function(n)
+	brightness = 255
+	if (n % 2 == 0) then
+		DMX_setColor(255, 0, 80)
+	else
+		DMX_setColor(0, 120, 255)
+	end
+end)
+
+onFrame(function(dt)
+	brightness = lerp(brightness, 0, math.min(dt * 4, 1))
+	DMX_setBrightness(brightness)
+end)
+
+onCue(function(name)
+	if (name == "weiss") then
+		DMX_setColor(255, 255, 255)
+	end
+end)
\ No newline at end of file
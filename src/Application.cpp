@@ -9,16 +9,15 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <iostream>
 #include <windows.h>
-#include <setupapi.h>
-#include <devguid.h>
-#include <regstr.h>
 #include <string>
 #include <vector>
 #include "SerialComm.h"
 #include <thread>
 #include <chrono>
 #include "Script.h"
+#include "DMXLuaLib.h"
 #include <filesystem>
+#include <algorithm>
 
 Application* Application::INSTANCE = nullptr;
 
@@ -29,21 +28,97 @@ static int windowHeight;
 static float dmxColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 static bool autoUpdate = false;
 static std::vector<std::string> usableUSBPorts;
+static uint32_t usableUSBPortsVersion = 0;
 int selectedUSBPortIndex = 0;
-int connectedStatus = 0;
 static bool syncMode = true;
 static int dmxChannelsSelected = 0;
+// The Id being typed, targetId only changes (and only gets replayed) once it is set
+static int targetIdField = 0;
+static int targetIdShown = 0;
 static bool dmxEnabled = false;
 static bool smoothing = false;
 static float smoothingSpeed = 0.001f;
-static Script* curScript = nullptr;
 static int scriptIndex = 0;
 static std::vector<std::string> scriptPaths;
-static std::thread* scriptThread;
-static int targetId = 0;
+// Only touched by the UI thread
+static std::thread* scriptThread = nullptr;
+static int scriptInstances = 0;
+static int scriptWorkers = 0;
+static int netProtocol = NET_PROTOCOL_ARTNET;
+static std::string netHost = "127.0.0.1";
+static int netUniverses = 1;
+static int netFirstUniverse = 1;
+static bool netLoopback = true;
+static uint64_t netLastPackets = 0;
+static double netLastTime = 0.0;
+static double netPacketsPerSecond = 0.0;
+static std::string sceneName;
+static int sceneNumber = 1;
+static std::string sceneStatus;
+static int fadeFrom = 1;
+static int fadeTo = 2;
+static float fadePosition = 0.0f;
+static float beatsPerMinute = 0.0f;
+static std::string cueName;
+static int pixelColumns = 8;
+static int pixelRows = 1;
+static int pixelUniverse = 0;
+static int pixelStart = 1;
+static bool pixelDRGB = false;
+static bool pixelSerpentine = false;
+static std::string pixelLayoutPath = "layout.txt";
+static std::string pixelSequencePath;
+// The .sfpx the pixel mapper has mapped, the path field above can be edited since
+static std::string openedSequencePath;
+static std::string pixelImageFolder;
+static int pixelRawWidth = 64;
+static int pixelRawHeight = 1;
+static float pixelFrameRate = 30.0f;
+static float pixelGamma = PIXEL_DEFAULT_GAMMA;
+static float pixelBrightness = 1.0f;
+static bool pixelPlaying = false;
+static bool pixelLoop = true;
+static std::string pixelStatus;
+static int colorMode = COLOR_MODE_RGB;
+static bool colorFine = false;
+static int colorCurve = COLOR_CURVE_LINEAR;
+static bool colorWhitePoint = false;
+static float colorTemperature = 6500.0f;
+static int colorUniverse = 0;
+static int colorStart = 1;
+static bool codecEnabled = false;
+static int codecMode = CODEC_MODE_ADAPTIVE;
+static int codecSlots = DMX_FRAME_MAX_SLOTS;
+static int codecKeyInterval = CODEC_DEFAULT_KEY_INTERVAL;
+static uint64_t codecLastBytes = 0;
+static double codecLastTime = 0.0;
+static double codecBytesPerSecond = 0.0;
+static std::string capturePath = "show.sfcp";
+static std::string captureStatus;
+static bool benchmarkDone = false;
+static CodecBenchmark benchmarkResults[CODEC_MODE_COUNT];
+static float simulationSeconds = 600.0f;
+static bool simulationRecord = false;
+static bool simulating = false;
+static std::chrono::steady_clock::time_point simulationWallStart;
+static std::string simulationStatus;
+// The live show while a simulation runs, it starts from all zero and this is put back afterwards
+static std::vector<uint8_t> liveUniverses;
+static ColorState liveColors;
+static bool livePixelPlaying = false;
+static double livePixelPosition = 0.0;
+static int liveTargetId = 0;
+static float liveParameters[SCRIPT_MAX_PARAMETERS];
+static int controlOscPort = CONTROL_OSC_DEFAULT_PORT;
+static int controlMidiPort = CONTROL_MIDI_DEFAULT_PORT;
+static bool controlLoopbackOnly = false;
+static int faderUniverse = 0;
+static std::string controlStatus;
 
 namespace fs = std::filesystem;
 
+#define SCENE_FILE "scenes.dmx"
+
 #define WIDTH 500
 #define HEIGHT 600
 #define WIDTHf 500.0f
@@ -92,52 +167,33 @@ void ScanScripts()
 	}
 }
 
-void ScanUSBPorts()
+void Application::Init()
 {
-	HDEVINFO hDevInfo;
-	SP_DEVINFO_DATA DeviceInfoData;
-	char portName[256];  // Buffer to store port names
-
-	// Initialize the structure before using it.
-	DeviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-
-	// Get a list of all connected devices with the COM class GUID
-	hDevInfo = SetupDiGetClassDevs(&GUID_DEVCLASS_PORTS, 0, 0, DIGCF_PRESENT);
-
-	if (hDevInfo == INVALID_HANDLE_VALUE) {
-		std::cerr << "SetupDiGetClassDevs failed." << std::endl;
-		return;
+	if (NetworkOutput::InitNetwork() == RESULT_ERROR)
+	{
+		std::cout << "Failed to initialize Winsock!" << std::endl;
 	}
-
-	// Enumerate through the devices to find the Arduino
-	DWORD index = 0;
-	while (SetupDiEnumDeviceInfo(hDevInfo, index, &DeviceInfoData)) {
-		// Get the friendly name of the device
-		if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &DeviceInfoData, SPDRP_FRIENDLYNAME, NULL, (PBYTE)portName, sizeof(portName), NULL)) {
-			// Check if the friendly name contains "Arduino"
-			std::string comPortName;
-			if (strstr(portName, "Arduino")) {
-				std::string friendlyNameStr(portName);
-				size_t startPos = friendlyNameStr.find("(COM");
-				size_t endPos = friendlyNameStr.find(")");
-				if (startPos != std::string::npos && endPos != std::string::npos && endPos > startPos) {
-					comPortName = friendlyNameStr.substr(startPos + 1, endPos - startPos - 1);
-					usableUSBPorts.push_back(comPortName);
-					// Additional filtering or processing can be done here
-				}
-			}
-		}
-		index++;
+	// Fixture colors first, then the scripts, pixel mapping last, so it wins on slots both write
+	scheduler.SetFrameCallback([this](double dt)
+	{
+		// External control first, so its changes are in this very frame
+		DispatchControlEvents();
+		colorPipeline.RunFrame();
+		scriptEngine.RunFrame(dt);
+		pixelMapper.RunFrame(dt);
+	});
+	scheduler.SetFrameSentCallback([this]() { controlInput.FrameSent(); });
+	// Only simulations have a frame limit. The script stops with the show, before
+	// the scheduler leaves the virtual clock and time could run on without it.
+	scheduler.SetLimitCallback([this]() { running = false; });
+	scheduler.Start(OUTPUT_DEFAULT_FPS);
+	discovery.Start([this]() { ReplayState(); });
+
+	if (scenes.Open(SCENE_FILE, scheduler.GetUniverseCount()) == RESULT_ERROR)
+	{
+		std::cout << "Failed to open scene file " << SCENE_FILE << "!" << std::endl;
 	}
 
-	// Clean up
-	SetupDiDestroyDeviceInfoList(hDevInfo);
-}
-
-void Application::Init()
-{
-	ScanUSBPorts();
-
 	if (!glfwInit())
 	{
 		std::cout << "Failed to initialize GLFW!" << std::endl;
@@ -209,6 +265,13 @@ void Application::Init()
 		glClear(GL_COLOR_BUFFER_BIT);
 		glfwPollEvents();
 
+		uint32_t recalled = pendingSceneSettings.exchange(SCENE_NOT_FOUND);
+		const SceneRecord* recalledRecord = scenes.GetRecord(recalled);
+		if (recalledRecord != nullptr)
+		{
+			ApplySceneSettings(recalledRecord->settings);
+		}
+
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -217,6 +280,14 @@ void Application::Init()
 		ImGui::SetNextWindowSize(ImVec2(500, HEIGHTf));
 		ImGui::Begin("dmx_controller", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoDecoration);
 
+		int connectedStatus = discovery.GetStatus();
+
+		if (discovery.GetPortsVersion() != usableUSBPortsVersion)
+		{
+			usableUSBPortsVersion = discovery.GetPortsVersion();
+			usableUSBPorts = discovery.GetPorts();
+		}
+
 		std::string selection;
 		for (std::string port : usableUSBPorts)
 		{
@@ -228,15 +299,13 @@ void Application::Init()
 		ImGui::Combo("Arduino Port", &selectedUSBPortIndex, selection.c_str());
 		if (ImGui::Button("Verbinden") && connectedStatus == CONN_STATUS_NOT_CONNECTED)
 		{
-			connectedStatus = CONN_STATUS_CONNECTING;
 			ConnectToArduino();
 		}
 
 		ImGui::SameLine();
-		if (ImGui::Button("Trennen") && connectedStatus == CONN_STATUS_CONNECTED)
+		if (ImGui::Button("Trennen") && connectedStatus != CONN_STATUS_NOT_CONNECTED)
 		{
-			connectedStatus = CONN_STATUS_NOT_CONNECTED;
-			comm.Close();
+			discovery.Disconnect();
 		}
 
 		ImGui::SameLine();
@@ -270,56 +339,28 @@ void Application::Init()
 
 		//ImGui::Checkbox(u8"Automatisch Senden", &autoUpdate);
 
-		if (ImGui::Checkbox("Sync-Modus", &syncMode) && connectedStatus == CONN_STATUS_CONNECTED)
+		if (ImGui::Checkbox("Sync-Modus", &syncMode))
 		{
-			comm.WriteByte(1);
-
-			std::string str;
-			str.append(std::to_string(CMD_SYNC_MODE));
-			str.push_back(':');
-			str.append(std::to_string(syncMode));
-
-			str.push_back(';');
-			comm.WriteString(str);
+			controls.syncMode = syncMode;
+			SendCommand(CMD_SYNC_MODE, std::to_string(syncMode));
 		}
 
 		if (ImGui::Checkbox("Smoothing", &smoothing))
 		{
-			comm.WriteByte(1);
-
-			std::string str;
-			str.append(std::to_string(CMD_SMOOTHING));
-			str.push_back(':');
-			str.append(std::to_string(smoothing));
-
-			str.push_back(';');
-			comm.WriteString(str);
+			controls.smoothing = smoothing;
+			SendCommand(CMD_SMOOTHING, std::to_string(smoothing));
 		}
 
 		if (ImGui::SliderFloat("Smoothing Speed", &smoothingSpeed, 0.001f, 0.35f))
 		{
-			comm.WriteByte(1);
-
-			std::string str;
-			str.append(std::to_string(CMD_SMOOTHING_SPEED));
-			str.push_back(':');
-			str.append(std::to_string(smoothingSpeed));
-
-			str.push_back(';');
-			comm.WriteString(str);
+			controls.smoothingSpeed = smoothingSpeed;
+			SendCommand(CMD_SMOOTHING_SPEED, std::to_string(smoothingSpeed));
 		}
 
 		if (ImGui::Checkbox("DMX", &dmxEnabled))
 		{
-			comm.WriteByte(1);
-
-			std::string str;
-			str.append(std::to_string(CMD_DMX_MODE));
-			str.push_back(':');
-			str.append(std::to_string(dmxEnabled));
-
-			str.push_back(';');
-			comm.WriteString(str);
+			controls.dmxEnabled = dmxEnabled;
+			SendCommand(CMD_DMX_MODE, std::to_string(dmxEnabled));
 		}
 
 		ImGui::SetNextItemWidth(75);
@@ -339,28 +380,23 @@ void Application::Init()
 			}
 			}
 
-			comm.WriteByte(1);
-
-			std::string str;
-			str.append(std::to_string(CMD_DMX_CHANNELS));
-			str.push_back(':');
-			str.append(std::to_string(dmxChannels));
-
-			str.push_back(';');
-			comm.WriteString(str);
+			colorPipeline.SetDefaultMode(dmxChannels == DMX_DRGB ? COLOR_MODE_DRGB : COLOR_MODE_RGB);
+			SendCommand(CMD_DMX_CHANNELS, std::to_string(dmxChannels.load()));
 		}
 
+		// Scripts and scenes change the id too (DMX_setId, recall), show those in the field
+		if (targetId != targetIdShown)
+		{
+			targetIdShown = targetId;
+			targetIdField = targetIdShown;
+		}
 		ImGui::SetNextItemWidth(80);
-		ImGui::InputInt("Id", &targetId);
+		ImGui::InputInt("Id", &targetIdField);
 		if (ImGui::Button("Licht Id Setzen"))
 		{
-			std::string str;
-			str.push_back(1);
-			str.append(std::to_string(CMD_TARGET_ID));
-			str.push_back(':');
-			str.append(std::to_string(targetId));
-			str.push_back(';');
-			Application::INSTANCE->comm.WriteString(str);
+			targetId = targetIdField;
+			targetIdShown = targetIdField;
+			SendCommand(CMD_TARGET_ID, std::to_string(targetIdField));
 		}
 
 		if (ImGui::Button("Farben Setzen"))
@@ -391,26 +427,45 @@ void Application::Init()
 		}
 		ImGui::Combo("Skript", &scriptIndex, s.c_str());
 		ImGui::SameLine();
-		if (ImGui::Button("Skript Starten"))
+		if (ImGui::Button("Skript Starten") && !IsSimulating())
 		{
-			if (curScript != nullptr)
-			{
-				running = false;
-				scriptThread->join();
-				delete curScript;
-				delete scriptThread;
-			}
-			running = true;
-			scriptThread = new std::thread([]() {
-				curScript = new Script(scriptPaths.at(scriptIndex));
-			});
+			// A loop-style script is stopped, event-driven ones keep running in the engine
+			StartScriptThread(scriptPaths.at(scriptIndex));
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Stoppen"))
+		{
+			StopScriptThread();
+			scriptEngine.Clear();
+			scriptInstances = 0;
+		}
+
+		if (ImGui::Button("Beat"))
+		{
+			scriptEngine.Beat();
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(120);
+		if (ImGui::SliderFloat("BPM (0 = aus)", &beatsPerMinute, 0.0f, 200.0f, "%.0f"))
+		{
+			scriptEngine.SetBeatsPerMinute(beatsPerMinute);
+		}
+		ImGui::SetNextItemWidth(150);
+		ImGui::InputText("##cue", &cueName);
+		ImGui::SameLine();
+		if (ImGui::Button("Cue Senden") && !cueName.empty())
+		{
+			scriptEngine.Cue(cueName);
 		}
 
 		ImGui::BeginChild("##script_actions", ImVec2(WIDTH - 15, 100), true);
 
-		for (std::string action : scriptActions)
 		{
-			ImGui::TextWrapped(action.c_str());
+			std::lock_guard<std::mutex> lock(scriptActionsMutex);
+			for (const std::string& action : scriptActions)
+			{
+				ImGui::TextWrapped("%s", action.c_str());
+			}
 		}
 
 		ImGui::EndChild();
@@ -420,6 +475,459 @@ void Application::Init()
 			ImGui::EndDisabled();
 		}
 
+		if (ImGui::CollapsingHeader("Farb-Pipeline"))
+		{
+			ImGui::SetNextItemWidth(100);
+			ImGui::Combo("Modus", &colorMode, "RGB\0DRGB\0RGBW\0RGBA\0");
+			ImGui::SameLine();
+			ImGui::Checkbox("16 Bit", &colorFine);
+			ImGui::SetNextItemWidth(100);
+			ImGui::Combo("Kurve", &colorCurve, "Linear\0Gamma 2.2\0Gamma 2.8\0CIE L*\0");
+			ImGui::Checkbox("Weisspunkt", &colorWhitePoint);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(150);
+			ImGui::SliderFloat("Kelvin", &colorTemperature, 2000.0f, 10000.0f, "%.0f");
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Universum##color", &colorUniverse);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Startkanal##color", &colorStart);
+
+			int id = targetId;
+			if (ImGui::Button("Profil fuer Id Setzen") && id >= 0 && colorUniverse >= 0 && colorUniverse < DMX_MAX_UNIVERSES && colorStart >= 1 && colorStart <= DMX_UNIVERSE_SIZE)
+			{
+				ColorProfile profile;
+				profile.universe = (uint16_t)colorUniverse;
+				profile.start = (uint16_t)(colorStart - 1);
+				profile.mode = (uint8_t)colorMode;
+				profile.fine = colorFine ? 1 : 0;
+				profile.curve = (uint8_t)colorCurve;
+				profile.temperature = colorWhitePoint ? colorTemperature : 0.0f;
+				colorPipeline.SetProfile((uint32_t)id, profile);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Profil der Id Laden") && id >= 0)
+			{
+				ColorProfile profile = colorPipeline.GetProfile((uint32_t)id);
+				colorUniverse = profile.universe;
+				colorStart = profile.start + 1;
+				colorMode = profile.mode;
+				colorFine = profile.fine != 0;
+				colorCurve = profile.curve;
+				colorWhitePoint = profile.temperature > 0.0f;
+				colorTemperature = colorWhitePoint ? profile.temperature : colorTemperature;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Zuruecksetzen") && id >= 0)
+			{
+				colorPipeline.ResetProfile((uint32_t)id);
+			}
+			ImGui::Text("%u Fixtures | Durchlauf: %u us", colorPipeline.GetFixtureCount(), colorPipeline.GetPassMicros());
+		}
+
+		if (ImGui::CollapsingHeader("Skript-Worker"))
+		{
+			if (scriptWorkers == 0)
+			{
+				scriptWorkers = (int)scriptEngine.GetWorkerCount();
+			}
+			ImGui::SetNextItemWidth(150);
+			if (ImGui::SliderInt("Worker", &scriptWorkers, 1, SCRIPT_MAX_WORKERS))
+			{
+				scriptEngine.SetWorkerCount((size_t)scriptWorkers);
+			}
+			ImGui::Text("%u Skripte | Frame: %u us", (unsigned int)scriptEngine.GetScriptCount(), scriptEngine.GetFrameMicros());
+			for (size_t i = 0; i < scriptEngine.GetWorkerCount(); i++)
+			{
+				ImGui::Text("Worker %u: %u Skripte, %u us", (unsigned int)i, scriptEngine.GetWorkerScriptCount(i), scriptEngine.GetWorkerMicros(i));
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Szenen"))
+		{
+			ImGui::SetNextItemWidth(150);
+			ImGui::InputText("Name", &sceneName);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Nummer", &sceneNumber);
+
+			if (ImGui::Button("Szene Speichern"))
+			{
+				uint32_t named = sceneName.empty() ? SCENE_NOT_FOUND : scenes.FindByName(sceneName.substr(0, SCENE_NAME_LENGTH - 1));
+				if (named != SCENE_NOT_FOUND && named != scenes.FindByNumber((uint32_t)sceneNumber))
+				{
+					sceneStatus = "Name schon vergeben";
+				}
+				else
+				{
+					sceneStatus = SaveScene(sceneName, sceneNumber) == RESULT_SUCCESS ? "Gespeichert" : "Speichern fehlgeschlagen";
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Nach Nummer Abrufen"))
+			{
+				sceneStatus = RecallScene(scenes.FindByNumber((uint32_t)sceneNumber)) == RESULT_SUCCESS ? "Abgerufen" : "Szene nicht gefunden";
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Nach Name Abrufen"))
+			{
+				sceneStatus = RecallScene(scenes.FindByName(sceneName)) == RESULT_SUCCESS ? "Abgerufen" : "Szene nicht gefunden";
+			}
+			ImGui::Text("%u Szenen | %s", scenes.GetCount(), sceneStatus.c_str());
+
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Von", &fadeFrom);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Nach", &fadeTo);
+			if (ImGui::SliderFloat("Ueberblenden", &fadePosition, 0.0f, 1.0f))
+			{
+				CrossfadeScenes(scenes.FindByNumber((uint32_t)fadeFrom), scenes.FindByNumber((uint32_t)fadeTo), fadePosition);
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Pixel-Mapping"))
+		{
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Spalten", &pixelColumns);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Zeilen", &pixelRows);
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Universum", &pixelUniverse);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Startkanal", &pixelStart);
+			ImGui::Checkbox("DRGB", &pixelDRGB);
+			ImGui::SameLine();
+			ImGui::Checkbox("Schlangenlinie", &pixelSerpentine);
+			if (ImGui::Button("Raster Uebernehmen") && pixelColumns > 0 && pixelRows > 0 && pixelUniverse >= 0 && pixelStart >= 1 && pixelStart <= DMX_UNIVERSE_SIZE)
+			{
+				pixelMapper.SetFixtures(PixelMapper::LayoutGrid((uint32_t)pixelColumns, (uint32_t)pixelRows, (uint16_t)pixelUniverse, (uint16_t)(pixelStart - 1),
+					pixelDRGB ? PIXEL_LAYOUT_DRGB : PIXEL_LAYOUT_RGB, pixelSerpentine));
+			}
+
+			ImGui::SetNextItemWidth(200);
+			ImGui::InputText("##pixel_layout", &pixelLayoutPath);
+			ImGui::SameLine();
+			if (ImGui::Button("Layout Laden"))
+			{
+				std::vector<PixelFixture> fixtures;
+				if (PixelMapper::LoadLayout(pixelLayoutPath, fixtures) == RESULT_SUCCESS)
+				{
+					pixelMapper.SetFixtures(fixtures);
+					pixelStatus = "Layout geladen";
+				}
+				else
+				{
+					pixelStatus = "Layout fehlerhaft";
+				}
+			}
+
+			// .sfpx files describe themselves, anything else is read as raw RGB24 with the size below
+			ImGui::SetNextItemWidth(200);
+			ImGui::InputText("##pixel_sequence", &pixelSequencePath);
+			ImGui::SameLine();
+			if (ImGui::Button("Sequenz Oeffnen"))
+			{
+				bool sfpx = ToLower(GetFileExtension(pixelSequencePath)) == "sfpx";
+				Result result = sfpx ? pixelMapper.OpenSequence(pixelSequencePath) :
+					pixelMapper.OpenRawSequence(pixelSequencePath, (uint32_t)pixelRawWidth, (uint32_t)pixelRawHeight, pixelFrameRate);
+				openedSequencePath = sfpx && result == RESULT_SUCCESS ? pixelSequencePath : "";
+				pixelStatus = result == RESULT_SUCCESS ? "Sequenz geoeffnet" : "Sequenz konnte nicht geoeffnet werden";
+			}
+			ImGui::SetNextItemWidth(60);
+			ImGui::InputInt("Breite", &pixelRawWidth, 0);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(60);
+			ImGui::InputInt("Hoehe", &pixelRawHeight, 0);
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(60);
+			ImGui::InputFloat("FPS", &pixelFrameRate);
+
+			ImGui::SetNextItemWidth(200);
+			ImGui::InputText("##pixel_images", &pixelImageFolder);
+			ImGui::SameLine();
+			if (ImGui::Button("PNG-Ordner Importieren"))
+			{
+				pixelStatus = ImportPixelImages(pixelImageFolder, pixelFrameRate) == RESULT_SUCCESS ? "Importiert" : "Import fehlgeschlagen";
+			}
+
+			if (ImGui::Checkbox("Abspielen", &pixelPlaying))
+			{
+				if (pixelPlaying)
+				{
+					pixelMapper.Play();
+				}
+				else
+				{
+					pixelMapper.Stop();
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Checkbox("Wiederholen", &pixelLoop))
+			{
+				pixelMapper.SetLoop(pixelLoop);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Zurueckspulen"))
+			{
+				pixelMapper.Rewind();
+			}
+			// Playback without loop stops by itself at the last frame
+			pixelPlaying = pixelMapper.IsPlaying();
+
+			if (ImGui::SliderFloat("Gamma", &pixelGamma, 1.0f, 3.0f))
+			{
+				pixelMapper.SetGamma(pixelGamma);
+			}
+			if (ImGui::SliderFloat("Helligkeit", &pixelBrightness, 0.0f, 1.0f))
+			{
+				pixelMapper.SetBrightness(pixelBrightness);
+			}
+			ImGui::Text("%u Fixtures | Frame %u/%u | %u us | %s", (unsigned int)pixelMapper.GetFixtureCount(), pixelMapper.GetFrameIndex() + 1, pixelMapper.GetFrameCount(),
+				pixelMapper.GetRenderMicros(), pixelStatus.c_str());
+		}
+
+		if (ImGui::CollapsingHeader("Serielle Kompression"))
+		{
+			if (ImGui::Checkbox("Komprimierte Frames", &codecEnabled))
+			{
+				serialOutput.SetCompression(codecEnabled);
+			}
+			ImGui::SetNextItemWidth(100);
+			if (ImGui::Combo("Kodierung", &codecMode, "Adaptiv\0Keyframes\0Bitmap\0RLE\0"))
+			{
+				serialOutput.GetEncoder().SetMode(codecMode);
+			}
+			ImGui::SetNextItemWidth(80);
+			if (ImGui::InputInt("Kanaele", &codecSlots))
+			{
+				codecSlots = codecSlots < 1 ? 1 : (codecSlots > DMX_FRAME_MAX_SLOTS ? DMX_FRAME_MAX_SLOTS : codecSlots);
+				serialOutput.GetEncoder().SetSlotCount((uint32_t)codecSlots);
+			}
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(80);
+			if (ImGui::InputInt("Keyframe-Intervall", &codecKeyInterval))
+			{
+				codecKeyInterval = codecKeyInterval < 1 ? 1 : codecKeyInterval;
+				serialOutput.GetEncoder().SetKeyInterval((uint32_t)codecKeyInterval);
+			}
+
+			FrameEncoder& encoder = serialOutput.GetEncoder();
+			double now = glfwGetTime();
+			if (now - codecLastTime >= 1.0)
+			{
+				uint64_t bytes = encoder.GetByteCount();
+				codecBytesPerSecond = (bytes - codecLastBytes) / (now - codecLastTime);
+				codecLastBytes = bytes;
+				codecLastTime = now;
+			}
+			// 8N1: ten bits on the line per byte
+			ImGui::Text("%.0f / %u Bytes/s | Key %llu | Bitmap %llu | RLE %llu | unveraendert %llu", codecBytesPerSecond, SERIAL_BAUD_RATE / 10,
+				(unsigned long long)encoder.GetFrameCount(DMX_FRAME_KEY), (unsigned long long)encoder.GetFrameCount(DMX_FRAME_BITMAP),
+				(unsigned long long)encoder.GetFrameCount(DMX_FRAME_RLE), (unsigned long long)encoder.GetUnchangedCount());
+
+			ImGui::SetNextItemWidth(200);
+			ImGui::InputText("##capture_path", &capturePath);
+			ImGui::SameLine();
+			if (recordingOutput.IsOpen())
+			{
+				if (ImGui::Button("Aufnahme stoppen"))
+				{
+					scheduler.RemoveOutput(&recordingOutput);
+					recordingOutput.Close();
+					captureStatus = std::to_string(recordingOutput.GetFrameCount()) + " Frames aufgenommen";
+				}
+			}
+			else if (ImGui::Button("Aufnahme starten"))
+			{
+				if (recordingOutput.Open(capturePath, (uint32_t)scheduler.GetUniverseCount(), scheduler.GetFrameRate()) == RESULT_SUCCESS)
+				{
+					scheduler.AddOutput(&recordingOutput);
+					captureStatus = "Nimmt auf";
+				}
+				else
+				{
+					captureStatus = "Datei konnte nicht geoeffnet werden";
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Benchmark"))
+			{
+				benchmarkDone = BenchmarkCapture(capturePath, (uint32_t)codecSlots, (uint32_t)codecKeyInterval, SERIAL_BAUD_RATE, benchmarkResults) == RESULT_SUCCESS;
+				captureStatus = benchmarkDone ? "" : "Aufnahme fehlerhaft";
+			}
+			if (recordingOutput.HasFailed())
+			{
+				captureStatus = "Schreibfehler";
+			}
+			ImGui::Text("%s", captureStatus.c_str());
+
+			if (benchmarkDone)
+			{
+				static const char* modeNames[CODEC_MODE_COUNT] = { "Adaptiv", "Keyframes", "Bitmap", "RLE" };
+				// Uncompressed reference: every frame as a keyframe
+				ImGui::Text("Unkomprimiert: %.1f Frames/s", (SERIAL_BAUD_RATE / 10.0) / (codecSlots + 2 + DMX_FRAME_OVERHEAD));
+				for (int i = 0; i < CODEC_MODE_COUNT; i++)
+				{
+					const CodecBenchmark& result = benchmarkResults[i];
+					ImGui::Text("%-10s %.1f Frames/s | %.1f Bytes/Frame | %.2f us | %s", modeNames[i], result.framesPerSecond, (double)result.bytes / result.frames,
+						result.encodeMicros, result.verified ? "OK" : "Dekodierfehler");
+				}
+			}
+		}
+
+		// Checked outside the section, a finished run has to hand the outputs back even when it is collapsed
+		if (simulating && !scheduler.IsRunning())
+		{
+			FinishSimulation();
+		}
+		if (ImGui::CollapsingHeader("Simulation"))
+		{
+			if (simulating)
+			{
+				ImGui::BeginDisabled();
+			}
+			ImGui::SetNextItemWidth(100);
+			ImGui::InputFloat("Showdauer (s)", &simulationSeconds, 0.0f, 0.0f, "%.0f");
+			ImGui::SameLine();
+			ImGui::Checkbox("Aufnehmen (Pfad unter Serielle Kompression)", &simulationRecord);
+			if (simulating)
+			{
+				ImGui::EndDisabled();
+				if (ImGui::Button("Abbrechen"))
+				{
+					FinishSimulation();
+				}
+			}
+			else if (ImGui::Button("Simulieren") && simulationSeconds > 0.0f && !scriptPaths.empty())
+			{
+				StartSimulation(simulationSeconds, simulationRecord, capturePath);
+			}
+			ImGui::SameLine();
+			if (simulating)
+			{
+				double virtualSeconds = virtualClock.NowMicros() / 1000000.0;
+				double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - simulationWallStart).count();
+				ImGui::Text("%.1f / %.0f s (x%.0f)", virtualSeconds, simulationSeconds, wallSeconds > 0.0 ? virtualSeconds / wallSeconds : 0.0);
+			}
+			else
+			{
+				ImGui::Text("%s", simulationStatus.c_str());
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Steuerung (OSC / MIDI)"))
+		{
+			bool listening = controlInput.IsRunning();
+			if (listening)
+			{
+				ImGui::BeginDisabled();
+			}
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("OSC-Port (0 = aus)", &controlOscPort, 0);
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("MIDI-Port (0 = aus)", &controlMidiPort, 0);
+			ImGui::Checkbox("Nur lokal (127.0.0.1)", &controlLoopbackOnly);
+			if (listening)
+			{
+				ImGui::EndDisabled();
+				if (ImGui::Button("Empfang stoppen"))
+				{
+					controlInput.Stop();
+				}
+			}
+			else if (ImGui::Button("Empfang starten"))
+			{
+				bool valid = controlOscPort >= 0 && controlOscPort <= 65535 && controlMidiPort >= 0 && controlMidiPort <= 65535;
+				controlStatus = valid && controlInput.Start((uint16_t)controlOscPort, (uint16_t)controlMidiPort, controlLoopbackOnly) == RESULT_SUCCESS ? "" :
+					"Ports konnten nicht geoeffnet werden";
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s", controlStatus.c_str());
+
+			ImGui::SetNextItemWidth(80);
+			if (ImGui::InputInt("Fader-Universum", &faderUniverse))
+			{
+				faderUniverse = faderUniverse < 0 ? 0 : faderUniverse;
+				controlFaderUniverse = faderUniverse;
+			}
+
+			ImGui::Text("Nachrichten: %llu | Unbekannt/fehlerhaft: %llu | Verworfen: %llu", (unsigned long long)controlInput.GetMessageCount(),
+				(unsigned long long)controlInput.GetInvalidCount(), (unsigned long long)controlInput.GetDroppedCount());
+			// Receive until the frame is handed to the outputs, the budget is one frame
+			ImGui::Text("Latenz: %.2f ms | Mittel %.2f ms | Max %.2f ms | ueber 1 Frame: %llu", controlInput.GetLatencyLastMicros() / 1000.0,
+				controlInput.GetLatencyAverageMicros() / 1000.0, controlInput.GetLatencyMaxMicros() / 1000.0, (unsigned long long)controlInput.GetLateFrameCount());
+			ImGui::SameLine();
+			if (ImGui::Button("Zuruecksetzen##latency"))
+			{
+				controlInput.ResetLatency();
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Netzwerk (Art-Net / sACN)"))
+		{
+			bool open = networkOutput.IsOpen();
+			if (open)
+			{
+				ImGui::BeginDisabled();
+			}
+
+			ImGui::SetNextItemWidth(100);
+			ImGui::Combo("Protokoll", &netProtocol, "Art-Net\0sACN\0");
+			ImGui::Checkbox("Loopback-Test (127.0.0.1)", &netLoopback);
+			if (!netLoopback)
+			{
+				ImGui::SetNextItemWidth(150);
+				ImGui::InputText("Ziel-IP (leer = Broadcast/Multicast)", &netHost);
+			}
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Universen", &netUniverses);
+			ImGui::SetNextItemWidth(80);
+			ImGui::InputInt("Erstes Universum", &netFirstUniverse);
+
+			if (open)
+			{
+				ImGui::EndDisabled();
+				if (ImGui::Button("Senden stoppen"))
+				{
+					StopNetworkOutput();
+				}
+			}
+			else if (ImGui::Button("Senden starten"))
+			{
+				StartNetworkOutput(netProtocol, netHost, netUniverses, netFirstUniverse, netLoopback);
+			}
+
+			ImGui::SameLine();
+			if (networkOutput.IsOpen())
+			{
+				ImGui::TextColored(ImVec4(0.0f, 0.75f, 0.0f, 1.0f), "Sendet");
+			}
+			else
+			{
+				ImGui::TextColored(ImVec4(0.75f, 0.0f, 0.0f, 1.0f), "Aus");
+			}
+
+			ImGui::Text("Gesendet: %llu Pakete | Fehler: %llu", (unsigned long long)networkOutput.GetPacketsSent(), (unsigned long long)networkOutput.GetSendErrors());
+
+			if (networkReceiver.IsRunning())
+			{
+				double now = glfwGetTime();
+				if (now - netLastTime >= 1.0)
+				{
+					uint64_t packets = networkReceiver.GetPacketCount();
+					netPacketsPerSecond = (packets - netLastPackets) / (now - netLastTime);
+					netLastPackets = packets;
+					netLastTime = now;
+				}
+
+				ImGui::Text("Empfangen: %llu Pakete (%.0f/s)", (unsigned long long)networkReceiver.GetPacketCount(), netPacketsPerSecond);
+				ImGui::Text("Fehlerhaft: %llu | Sequenzfehler: %llu", (unsigned long long)networkReceiver.GetInvalidCount(), (unsigned long long)networkReceiver.GetSequenceErrorCount());
+			}
+		}
+
 		ImGui::End();
 
 		ImGui::Render();
@@ -432,82 +940,512 @@ void Application::Init()
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 	glfwTerminate();
-	running = false;
-	if (connectedStatus == CONN_STATUS_CONNECTED)
+	// Producers first: control input and the loop script feed the output, discovery
+	// queues replays and the scheduler runs the script handlers. Each Stop() joins
+	// before returning.
+	controlInput.Stop();
+	StopScriptThread();
+	discovery.Stop();
+	scheduler.Stop();
+	scriptEngine.Clear();
+	StopNetworkOutput();
+	scheduler.RemoveOutput(&recordingOutput);
+	recordingOutput.Close();
+	NetworkOutput::ShutdownNetwork();
+	scenes.Close();
+}
+
+void Application::UpdateDMXColors(float* colors)
+{
+	if (colors == nullptr)
 	{
-		comm.Close();
+		colors = dmxColor;
 	}
-	if (curScript != nullptr)
+
+	// Fixture <targetId> is patched by its color profile (by default dmxChannels
+	// slots from targetId * dmxChannels in universe 0), the pipeline writes it on the next frame
+	int id = targetId;
+	if (id >= 0)
 	{
-		delete curScript;
-		scriptThread->join();
-		delete scriptThread;
+		colorPipeline.SetColor((uint32_t)id, colors);
 	}
-}
 
-void Application::UpdateDMXColors(float* colors)
-{
-	if (connectedStatus == CONN_STATUS_CONNECTED)
+	if (discovery.GetStatus() == CONN_STATUS_CONNECTED)
 	{
+		// The Arduino gets plain 8 bit values, a curve before rounding would merge the low steps
+		int values[4];
+		for (int i = 0; i < 4; i++)
+		{
+			float c = colors[i] > 0.0f ? (colors[i] < 1.0f ? colors[i] : 1.0f) : 0.0f;
+			values[i] = (int)(c * 255.0f + 0.5f);
+		}
+
 		std::string str;
 		str.push_back(1);
+		str.append(std::to_string(values[0]));
+		str.push_back(':');
+		str.append(std::to_string(values[1]));
+		str.push_back(':');
+		str.append(std::to_string(values[2]));
+		str.push_back(':');
+		str.append(std::to_string(values[3]));
+		str.push_back(';');
+		serialOutput.QueueColor(str);
+	}
+}
+
+void Application::SendCommand(int command, const std::string& value)
+{
+	if (discovery.GetStatus() != CONN_STATUS_CONNECTED)
+	{
+		return;
+	}
 
-		if (colors != nullptr)
+	std::string str;
+	str.push_back(1);
+	str.append(std::to_string(command));
+	str.push_back(':');
+	str.append(value);
+	str.push_back(';');
+	serialOutput.QueueMessage(str);
+}
+
+void Application::StartScriptThread(const std::string& path)
+{
+	StopScriptThread();
+	running = true;
+	int instance = scriptInstances++;
+	// Attached here and not on the thread, so on the virtual clock the script is
+	// ordered before everything that is started after it
+	Clock* scriptClock = clock;
+	int participant = scriptClock->Attach();
+	scriptThread = new std::thread([this, path, instance, scriptClock, participant]() {
+		DMXLuaLib::SetClock(scriptClock, participant);
+		scriptClock->SleepUntil(participant, scriptClock->NowMicros());
+		ClearScriptActions();
+		Script* script = new Script(path, instance);
+		// A script cut off by Stoppen or the end of a simulation is no error
+		if (!script->GetError().empty() && running)
 		{
-			str.append(std::to_string((int)(colors[0] * 255.0f)));
+			MessageBoxA(NULL, script->GetError().c_str(), "Lua Error", MB_OK | MB_ICONERROR);
 		}
-		else
+		AddScriptAction("Done");
+		// Scripts that registered handlers are driven by the output tick from now on
+		if (script->HasHandlers())
 		{
-			str.append(std::to_string((int)(dmxColor[0] * 255.0f)));
-		}
-		str.push_back(':');
-		if (colors != nullptr)
-		{
-			str.append(std::to_string((int)(colors[1] * 255.0f)));
+			scriptEngine.Add(script);
 		}
 		else
 		{
-			str.append(std::to_string((int)(dmxColor[1] * 255.0f)));
+			delete script;
 		}
-		str.push_back(':');
-		if (colors != nullptr)
-		{
-			str.append(std::to_string((int)(colors[2] * 255.0f)));
+		scriptClock->Detach(participant);
+	});
+}
+
+void Application::StopScriptThread()
+{
+	if (scriptThread == nullptr)
+	{
+		return;
+	}
+	running = false;
+	scriptThread->join();
+	delete scriptThread;
+	scriptThread = nullptr;
+}
+
+void Application::ConnectToArduino()
+{
+	if (usableUSBPorts.size() < 1 || selectedUSBPortIndex < 0 || selectedUSBPortIndex >= (int)usableUSBPorts.size())
+	{
+		return;
+	}
+	discovery.Connect(usableUSBPorts.at(selectedUSBPortIndex));
+}
+
+void Application::ReplayState()
+{
+	// Runs on the discovery thread right after the port was (re)opened, before the
+	// serial output is back on the scheduler, so everything goes out in one frame
+	SendControlSettings();
+	serialOutput.ReplayColor();
+}
+
+void Application::SendControlSettings()
+{
+	// Also runs on the discovery thread, so only the atomics are read here
+	SendCommand(CMD_SYNC_MODE, std::to_string(controls.syncMode.load()));
+	SendCommand(CMD_SMOOTHING, std::to_string(controls.smoothing.load()));
+	SendCommand(CMD_SMOOTHING_SPEED, std::to_string(controls.smoothingSpeed.load()));
+	SendCommand(CMD_DMX_MODE, std::to_string(controls.dmxEnabled.load()));
+	SendCommand(CMD_DMX_CHANNELS, std::to_string(dmxChannels.load()));
+	SendCommand(CMD_TARGET_ID, std::to_string(targetId.load()));
+}
+
+void Application::AddScriptAction(const std::string& action)
+{
+	std::lock_guard<std::mutex> lock(scriptActionsMutex);
+	if (scriptActions.size() >= SCRIPT_ACTIONS_MAX)
+	{
+		scriptActions.erase(scriptActions.begin());
+	}
+	scriptActions.push_back(action);
+}
+
+void Application::ClearScriptActions()
+{
+	std::lock_guard<std::mutex> lock(scriptActionsMutex);
+	scriptActions.clear();
+}
+
+Result Application::SaveScene(const std::string& name, int number)
+{
+	if (number < 0)
+	{
+		return RESULT_ERROR;
+	}
+
+	SceneSettings settings;
+	settings.syncMode = syncMode;
+	settings.smoothing = smoothing;
+	settings.dmxEnabled = dmxEnabled;
+	settings.dmxChannels = (uint8_t)dmxChannels;
+	settings.smoothingSpeed = smoothingSpeed;
+	settings.targetId = targetId;
+	memcpy(settings.color, dmxColor, sizeof(settings.color));
+
+	// Save can grow and flush the scene file, the output thread must not wait for that
+	size_t universeCount;
+	std::vector<uint8_t> snapshot;
+	uint8_t* universes = scheduler.BeginWrite(&universeCount);
+	snapshot.assign(universes, universes + universeCount * DMX_UNIVERSE_SIZE);
+	scheduler.EndWrite(0);
+	return scenes.Save(name, (uint32_t)number, snapshot.data(), universeCount, settings);
+}
+
+Result Application::RecallScene(uint32_t index)
+{
+	const SceneRecord* record = scenes.GetRecord(index);
+	if (record == nullptr)
+	{
+		return RESULT_ERROR;
+	}
+
+	size_t universeCount;
+	uint8_t* universes = scheduler.BeginWrite(&universeCount);
+	size_t stored = scenes.GetSceneUniverseCount(index);
+	size_t count = universeCount < stored ? universeCount : stored;
+	memcpy(universes, scenes.GetUniverses(index), count * DMX_UNIVERSE_SIZE);
+	scheduler.EndWrite();
+
+	ApplySceneSettings(record->settings);
+	return RESULT_SUCCESS;
+}
+
+void Application::ApplySceneSettings(const SceneSettings& settings)
+{
+	syncMode = settings.syncMode != 0;
+	smoothing = settings.smoothing != 0;
+	dmxEnabled = settings.dmxEnabled != 0;
+	dmxChannels = settings.dmxChannels == DMX_DRGB ? DMX_DRGB : DMX_RGB;
+	dmxChannelsSelected = dmxChannels == DMX_DRGB ? 1 : 0;
+	colorPipeline.SetDefaultMode(dmxChannels == DMX_DRGB ? COLOR_MODE_DRGB : COLOR_MODE_RGB);
+	smoothingSpeed = settings.smoothingSpeed;
+	targetId = settings.targetId;
+	memcpy(dmxColor, settings.color, sizeof(dmxColor));
+	controls.syncMode = syncMode;
+	controls.smoothing = smoothing;
+	controls.dmxEnabled = dmxEnabled;
+	controls.smoothingSpeed = smoothingSpeed;
+
+	SendControlSettings();
+	UpdateDMXColors(nullptr);
+}
+
+void Application::CrossfadeScenes(uint32_t from, uint32_t to, float t)
+{
+	const SceneRecord* a = scenes.GetRecord(from);
+	const SceneRecord* b = scenes.GetRecord(to);
+	if (a == nullptr || b == nullptr)
+	{
+		return;
+	}
+
+	size_t universeCount;
+	uint8_t* universes = scheduler.BeginWrite(&universeCount);
+	scenes.Crossfade(from, to, t, universes, universeCount);
+	scheduler.EndWrite();
+
+	// The Arduino only knows the target light, give it the mixed color
+	float color[4];
+	for (int i = 0; i < 4; i++)
+	{
+		color[i] = a->settings.color[i] + (b->settings.color[i] - a->settings.color[i]) * t;
+	}
+	UpdateDMXColors(color);
+}
+
+void Application::StartNetworkOutput(int protocol, const std::string& host, int universeCount, int firstUniverse, bool loopback)
+{
+	StopNetworkOutput();
+
+	if (universeCount < 1)
+	{
+		universeCount = 1;
+	}
+	if (universeCount > NET_MAX_UNIVERSES)
+	{
+		universeCount = NET_MAX_UNIVERSES;
+	}
+	if (firstUniverse < 0 || (protocol == NET_PROTOCOL_SACN && firstUniverse < 1))
+	{
+		// sACN universes start at 1
+		firstUniverse = protocol == NET_PROTOCOL_SACN ? 1 : 0;
+	}
+
+	if (loopback && networkReceiver.Start(protocol) == RESULT_ERROR)
+	{
+		std::cout << "Failed to start loopback receiver!" << std::endl;
+	}
+
+	scheduler.SetUniverseCount(universeCount);
+	if (networkOutput.Open(protocol, loopback ? "127.0.0.1" : host, universeCount, (uint16_t)firstUniverse) == RESULT_ERROR)
+	{
+		std::cout << "Failed to open network output!" << std::endl;
+		networkReceiver.Stop();
+		return;
+	}
+	scheduler.AddOutput(&networkOutput);
+}
+
+void Application::StopNetworkOutput()
+{
+	scheduler.RemoveOutput(&networkOutput);
+	networkOutput.Close();
+	networkReceiver.Stop();
+}
+
+Result Application::ImportPixelImages(const std::string& folder, float frameRate)
+{
+	// Frames are the folder's PNGs in name order (frame_0001.png, frame_0002.png, ...)
+	std::vector<std::string> images;
+	try {
+		for (const auto& entry : fs::directory_iterator(folder)) {
+			if (fs::is_regular_file(entry) && ToLower(GetFileExtension(entry.path().string())) == "png")
+			{
+				images.push_back(entry.path().string());
+			}
 		}
-		else
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return RESULT_ERROR;
+	}
+	std::sort(images.begin(), images.end());
+
+	// "frames/" and "frames" both become frames.sfpx next to the folder
+	fs::path folderPath(folder);
+	if (!folderPath.has_filename())
+	{
+		folderPath = folderPath.parent_path();
+	}
+	std::string path = folderPath.string() + ".sfpx";
+
+	// A mapped file cannot be replaced, close the playing sequence for the import
+	bool replacing = path == openedSequencePath;
+	double position = pixelMapper.GetPosition();
+	if (replacing)
+	{
+		pixelMapper.CloseSequence();
+		openedSequencePath = "";
+	}
+	if (FrameSequence::Import(images, path, frameRate) == RESULT_ERROR)
+	{
+		// The old file is still there, carry on where it was
+		if (replacing && pixelMapper.OpenSequence(path) == RESULT_SUCCESS)
 		{
-			str.append(std::to_string((int)(dmxColor[2] * 255.0f)));
+			pixelMapper.SetPosition(position);
+			openedSequencePath = path;
 		}
-		str.push_back(':');
-		if (colors != nullptr)
+		return RESULT_ERROR;
+	}
+	pixelSequencePath = path;
+	Result result = pixelMapper.OpenSequence(path);
+	openedSequencePath = result == RESULT_SUCCESS ? path : "";
+	return result;
+}
+
+
+void Application::StartSimulation(double seconds, bool record, const std::string& path)
+{
+	if (simulating || scriptPaths.empty())
+	{
+		return;
+	}
+
+	// Nothing of the live show carries over, the run starts from the script alone
+	StopScriptThread();
+	scriptEngine.Clear();
+	scriptInstances = 0;
+	// Discovery closes the port and takes the serial output off the scheduler
+	discovery.Stop();
+	scheduler.Stop();
+	scheduler.RemoveOutput(&networkOutput);
+	scheduler.RemoveOutput(&recordingOutput);
+	recordingOutput.Close();
+
+	size_t universeCount;
+	uint8_t* universes = scheduler.BeginWrite(&universeCount);
+	liveUniverses.assign(universes, universes + universeCount * DMX_UNIVERSE_SIZE);
+	memset(universes, 0, universeCount * DMX_UNIVERSE_SIZE);
+	scheduler.EndWrite();
+	colorPipeline.SaveColors(liveColors);
+	colorPipeline.LoadColors(ColorState());
+	livePixelPlaying = pixelMapper.IsPlaying();
+	livePixelPosition = pixelMapper.GetPosition();
+	pixelMapper.Stop();
+	liveTargetId = targetId;
+	targetId = 0;
+	for (size_t i = 0; i < SCRIPT_MAX_PARAMETERS; i++)
+	{
+		liveParameters[i] = scriptEngine.GetParameter(i);
+		scriptEngine.SetParameter(i, 0.0f);
+	}
+	scriptEngine.ResetBeats();
+
+	virtualClock.Reset();
+	clock = &virtualClock;
+	scheduler.SetClock(&virtualClock);
+	nullOutput.Reset();
+	scheduler.AddOutput(&nullOutput);
+	if (record)
+	{
+		if (recordingOutput.Open(path, (uint32_t)scheduler.GetUniverseCount(), OUTPUT_DEFAULT_FPS) == RESULT_SUCCESS)
 		{
-			str.append(std::to_string((int)(colors[3] * 255.0f)));
+			scheduler.AddOutput(&recordingOutput);
 		}
 		else
 		{
-			str.append(std::to_string((int)(dmxColor[3] * 255.0f)));
+			std::cout << "Failed to open capture " << path << "!" << std::endl;
 		}
-
-
-		str.push_back(';');
-		comm.WriteString(str);
 	}
+
+	simulating = true;
+	simulationWallStart = std::chrono::steady_clock::now();
+	// The script attaches first and runs its first step at time 0 before the first frame
+	StartScriptThread(scriptPaths.at(scriptIndex));
+	scheduler.Start(OUTPUT_DEFAULT_FPS, (uint64_t)(seconds * OUTPUT_DEFAULT_FPS + 0.5));
+	virtualClock.Resume();
 }
 
-void Application::ConnectToArduino()
+void Application::FinishSimulation()
 {
-	if (usableUSBPorts.size() < 1)
+	if (!simulating)
 	{
-		connectedStatus = CONN_STATUS_NOT_CONNECTED;
 		return;
 	}
-	Result result = comm.Open(SerialComm::GetDevice(usableUSBPorts.at(selectedUSBPortIndex)), 115200);
-	if (result == RESULT_ERROR)
+
+	// The scheduler keeps the virtual clock moving until the script has seen 'running' drop
+	StopScriptThread();
+	scheduler.Stop();
+	scriptEngine.Clear();
+	scriptInstances = 0;
+
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - simulationWallStart).count();
+	// The clock itself may have moved on a little for the script after the last frame
+	double virtualSeconds = scheduler.GetLastFrameMicros() / 1000000.0;
+	char status[160];
+	snprintf(status, sizeof(status), "%llu Frames, %.1f s in %.2f s (x%.0f) | Pruefsumme %016llx", (unsigned long long)nullOutput.GetFrameCount(), virtualSeconds,
+		wallSeconds, wallSeconds > 0.0 ? virtualSeconds / wallSeconds : 0.0, (unsigned long long)nullOutput.GetChecksum());
+	simulationStatus = status;
+
+	scheduler.RemoveOutput(&nullOutput);
+	scheduler.RemoveOutput(&recordingOutput);
+	recordingOutput.Close();
+
+	// The last simulated frame must not reach the rig, the live outputs come back with the live show
+	size_t universeCount;
+	uint8_t* universes = scheduler.BeginWrite(&universeCount);
+	size_t liveCount = liveUniverses.size() / DMX_UNIVERSE_SIZE;
+	memset(universes, 0, universeCount * DMX_UNIVERSE_SIZE);
+	memcpy(universes, liveUniverses.data(), (universeCount < liveCount ? universeCount : liveCount) * DMX_UNIVERSE_SIZE);
+	scheduler.EndWrite();
+	colorPipeline.LoadColors(liveColors);
+	pixelMapper.SetPosition(livePixelPosition);
+	if (livePixelPlaying)
+	{
+		pixelMapper.Play();
+	}
+	targetId = liveTargetId;
+	for (size_t i = 0; i < SCRIPT_MAX_PARAMETERS; i++)
+	{
+		scriptEngine.SetParameter(i, liveParameters[i]);
+	}
+
+	clock = &realClock;
+	scheduler.SetClock(&realClock);
+	if (networkOutput.IsOpen())
+	{
+		scheduler.AddOutput(&networkOutput);
+	}
+	simulating = false;
+	scheduler.Start(OUTPUT_DEFAULT_FPS);
+	discovery.Start([this]() { ReplayState(); });
+}
+
+bool Application::IsSimulating()
+{
+	return simulating;
+}
+
+void Application::DispatchControlEvents()
+{
+	// Wall clock input would make a simulation depend on when packets happened to arrive
+	if (scheduler.GetClock()->IsSimulated())
 	{
-		connectedStatus = CONN_STATUS_NOT_CONNECTED;
+		controlInput.Discard();
+		return;
 	}
-	else
+
+	ControlEvent event;
+	while (controlInput.Poll(event))
 	{
-		connectedStatus = CONN_STATUS_CONNECTED;
+		switch (event.type)
+		{
+		case CONTROL_EVENT_CUE:
+			// Same thread as RunFrame, straight into the frame's cue slots
+			scriptEngine.FrameCue(event.name);
+			break;
+		case CONTROL_EVENT_BEAT:
+			scriptEngine.FrameBeat();
+			break;
+		case CONTROL_EVENT_PARAMETER:
+			scriptEngine.SetParameter(event.index, event.value);
+			break;
+		case CONTROL_EVENT_FADER:
+		{
+			int universe = controlFaderUniverse;
+			if (universe >= 0 && event.index >= 1 && event.index <= DMX_UNIVERSE_SIZE)
+			{
+				uint8_t level = (uint8_t)(event.value * 255.0f + 0.5f);
+				scheduler.SetChannels((size_t)universe, event.index - 1, &level, 1);
+			}
+			break;
+		}
+		case CONTROL_EVENT_SCENE:
+		{
+			// The look goes out with this frame, the UI catches up with the scene's settings
+			size_t universeCount;
+			uint8_t* universes = scheduler.BeginWrite(&universeCount);
+			uint32_t index = scenes.Recall(event.index, universes, universeCount);
+			scheduler.EndWrite(index != SCENE_NOT_FOUND ? OUTPUT_ALL_UNIVERSES : 0);
+			if (index != SCENE_NOT_FOUND)
+			{
+				pendingSceneSettings = index;
+			}
+			break;
+		}
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "Clock.h"
+#include <chrono>
+#include <algorithm>
+
+RealClock::RealClock() : m_NextId(1)
+{
+
+}
+
+uint64_t RealClock::NowMicros()
+{
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int RealClock::Attach()
+{
+	return m_NextId++;
+}
+
+void RealClock::Detach(int participant)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Interrupted.erase(std::remove(m_Interrupted.begin(), m_Interrupted.end(), participant), m_Interrupted.end());
+}
+
+void RealClock::SleepUntil(int participant, uint64_t micros)
+{
+	using namespace std::chrono;
+	steady_clock::time_point until(duration_cast<steady_clock::duration>(microseconds(micros)));
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	// An interrupt that came in before we got here still counts, it is not lost between check and sleep
+	m_Condition.wait_until(lock, until, [this, participant]() { return std::find(m_Interrupted.begin(), m_Interrupted.end(), participant) != m_Interrupted.end(); });
+	m_Interrupted.erase(std::remove(m_Interrupted.begin(), m_Interrupted.end(), participant), m_Interrupted.end());
+}
+
+void RealClock::Interrupt(int participant)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (std::find(m_Interrupted.begin(), m_Interrupted.end(), participant) == m_Interrupted.end())
+		{
+			m_Interrupted.push_back(participant);
+		}
+	}
+	m_Condition.notify_all();
+}
+
+VirtualClock::VirtualClock() : m_Now(0), m_Running(-1), m_NextId(0), m_Paused(false)
+{
+
+}
+
+void VirtualClock::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Participants.clear();
+	m_Now = 0;
+	m_Running = -1;
+	m_NextId = 0;
+	m_Paused = true;
+}
+
+void VirtualClock::Resume()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Paused = false;
+	Dispatch();
+}
+
+void VirtualClock::Dispatch()
+{
+	if (m_Paused || m_Running != -1 || m_Participants.empty())
+	{
+		return;
+	}
+
+	// Ids grow in attach order, the earlier participant wins a tie
+	const Participant* next = &m_Participants[0];
+	for (const Participant& participant : m_Participants)
+	{
+		if (participant.wake < next->wake || (participant.wake == next->wake && participant.id < next->id))
+		{
+			next = &participant;
+		}
+	}
+	if (next->wake > m_Now)
+	{
+		m_Now = next->wake;
+	}
+	m_Running = next->id;
+	m_Condition.notify_all();
+}
+
+int VirtualClock::Attach()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	int id = m_NextId++;
+	m_Participants.push_back({ id, m_Now });
+	Dispatch();
+	return id;
+}
+
+void VirtualClock::Detach(int participant)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Participants.erase(std::remove_if(m_Participants.begin(), m_Participants.end(), [participant](const Participant& p) { return p.id == participant; }),
+		m_Participants.end());
+	if (m_Running == participant)
+	{
+		m_Running = -1;
+		Dispatch();
+	}
+}
+
+void VirtualClock::SleepUntil(int participant, uint64_t micros)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (Participant& p : m_Participants)
+	{
+		if (p.id == participant)
+		{
+			p.wake = micros > m_Now ? micros : m_Now.load();
+		}
+	}
+	if (m_Running == participant)
+	{
+		m_Running = -1;
+		Dispatch();
+	}
+	m_Condition.wait(lock, [this, participant]() { return m_Running == participant; });
+}
@@ -0,0 +1,383 @@
+#include "ColorPipeline.h"
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define COLOR_SSE2
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+struct ColorCurves
+{
+	uint16_t lut[COLOR_CURVE_COUNT][COLOR_LUT_SIZE];
+
+	ColorCurves()
+	{
+		for (int i = 0; i < COLOR_LUT_SIZE; i++)
+		{
+			double v = (double)i / (COLOR_LUT_SIZE - 1);
+			// CIE 1931 lightness to luminance
+			double l = v * 100.0;
+			double cie = l <= 8.0 ? l / 903.3 : pow((l + 16.0) / 116.0, 3.0);
+
+			lut[COLOR_CURVE_LINEAR][i] = (uint16_t)(v * 65535.0 + 0.5);
+			lut[COLOR_CURVE_GAMMA22][i] = (uint16_t)(pow(v, 2.2) * 65535.0 + 0.5);
+			lut[COLOR_CURVE_GAMMA28][i] = (uint16_t)(pow(v, 2.8) * 65535.0 + 0.5);
+			lut[COLOR_CURVE_CIE][i] = (uint16_t)(cie * 65535.0 + 0.5);
+		}
+	}
+};
+
+// Built once on first use
+static const ColorCurves& Curves()
+{
+	static const ColorCurves curves;
+	return curves;
+}
+
+ColorPipeline::ColorPipeline(OutputScheduler* scheduler) : m_Scheduler(scheduler), m_DefaultMode(COLOR_MODE_RGB), m_Dirty(false), m_FixtureCount(0), m_PassMicros(0)
+{
+	Curves();
+}
+
+size_t ColorPipeline::GetFootprint(const ColorProfile& profile)
+{
+	size_t channels = profile.mode == COLOR_MODE_RGB ? 3 : 4;
+	return profile.fine ? channels * 2 : channels;
+}
+
+uint16_t ColorPipeline::Apply(uint8_t curve, float value)
+{
+	const uint16_t* lut = Curves().lut[curve < COLOR_CURVE_COUNT ? curve : COLOR_CURVE_LINEAR];
+	if (!(value > 0.0f))
+	{
+		return lut[0];
+	}
+	if (value >= 1.0f)
+	{
+		return lut[COLOR_LUT_SIZE - 1];
+	}
+
+	float x = value * (COLOR_LUT_SIZE - 1);
+	int i = (int)x;
+	float f = x - i;
+	return (uint16_t)(lut[i] + (lut[i + 1] - lut[i]) * f + 0.5f);
+}
+
+void ColorPipeline::TemperatureGains(float kelvin, float* gains)
+{
+	// Black body approximation by Tanner Helland, good enough for a white point
+	double t = kelvin / 100.0;
+	double r = t <= 66.0 ? 255.0 : 329.698727446 * pow(t - 60.0, -0.1332047592);
+	double g = t <= 66.0 ? 99.4708025861 * log(t) - 161.1195681661 : 288.1221695283 * pow(t - 60.0, -0.0755148492);
+	double b = t >= 66.0 ? 255.0 : (t <= 19.0 ? 0.0 : 138.5177312231 * log(t - 10.0) - 305.0447927307);
+
+	double rgb[3] = { r, g, b };
+	double max = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		rgb[i] = rgb[i] < 0.0 ? 0.0 : (rgb[i] > 255.0 ? 255.0 : rgb[i]);
+		max = rgb[i] > max ? rgb[i] : max;
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		gains[i] = max > 0.0 ? (float)(rgb[i] / max) : 1.0f;
+	}
+}
+
+ColorProfile ColorPipeline::DefaultProfile(uint32_t fixture)
+{
+	ColorProfile profile;
+	profile.universe = 0;
+	profile.mode = m_DefaultMode;
+	profile.fine = 0;
+	// Curves are opt-in per profile, so existing shows keep their levels
+	profile.curve = COLOR_CURVE_LINEAR;
+	profile.temperature = 0.0f;
+	profile.start = (uint16_t)(fixture * GetFootprint(profile));
+	return profile;
+}
+
+void ColorPipeline::Resize(uint32_t count)
+{
+	uint32_t previous = (uint32_t)m_Profiles.size();
+	size_t padded = (count + 3) & ~(size_t)3;
+
+	m_Profiles.resize(count);
+	m_Configured.resize(count, 0);
+	m_Active.resize(count, 0);
+	m_Changed.resize(count, 0);
+	m_Red.resize(padded, 0.0f);
+	m_Green.resize(padded, 0.0f);
+	m_Blue.resize(padded, 0.0f);
+	m_Intensity.resize(padded, 0.0f);
+	m_GainRed.resize(padded, 1.0f);
+	m_GainGreen.resize(padded, 1.0f);
+	m_GainBlue.resize(padded, 1.0f);
+	m_DimmerMask.resize(padded, 0.0f);
+	m_WhiteMask.resize(padded, 0.0f);
+	m_AmberMask.resize(padded, 0.0f);
+	m_Channels.resize(padded * 4, 0.0f);
+
+	for (uint32_t i = previous; i < count; i++)
+	{
+		UpdateProfile(i, DefaultProfile(i), false);
+	}
+	m_FixtureCount = count;
+}
+
+void ColorPipeline::UpdateProfile(uint32_t fixture, const ColorProfile& profile, bool write)
+{
+	m_Profiles[fixture] = profile;
+
+	float gains[3] = { 1.0f, 1.0f, 1.0f };
+	if (profile.temperature > 0.0f)
+	{
+		TemperatureGains(profile.temperature, gains);
+	}
+	m_GainRed[fixture] = gains[0];
+	m_GainGreen[fixture] = gains[1];
+	m_GainBlue[fixture] = gains[2];
+	m_DimmerMask[fixture] = profile.mode == COLOR_MODE_DRGB ? 1.0f : 0.0f;
+	m_WhiteMask[fixture] = profile.mode == COLOR_MODE_RGBW ? 1.0f : 0.0f;
+	m_AmberMask[fixture] = profile.mode == COLOR_MODE_RGBA ? 1.0f : 0.0f;
+	if (write)
+	{
+		m_Changed[fixture] = 1;
+		m_Dirty = true;
+	}
+}
+
+void ColorPipeline::SetProfile(uint32_t fixture, const ColorProfile& profile)
+{
+	if (fixture >= COLOR_MAX_FIXTURES)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (fixture >= m_Profiles.size())
+	{
+		Resize(fixture + 1);
+	}
+	m_Configured[fixture] = 1;
+	UpdateProfile(fixture, profile, true);
+}
+
+void ColorPipeline::ResetProfile(uint32_t fixture)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (fixture < m_Profiles.size())
+	{
+		m_Configured[fixture] = 0;
+		UpdateProfile(fixture, DefaultProfile(fixture), true);
+	}
+}
+
+ColorProfile ColorPipeline::GetProfile(uint32_t fixture)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return fixture < m_Profiles.size() ? m_Profiles[fixture] : DefaultProfile(fixture);
+}
+
+void ColorPipeline::SetDefaultMode(uint8_t mode)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_DefaultMode = mode == COLOR_MODE_DRGB ? COLOR_MODE_DRGB : COLOR_MODE_RGB;
+	// Scene recall sets the mode after it loaded the universes. The new patch is
+	// written with the next color of each fixture, not with the colors it had.
+	for (uint32_t i = 0; i < m_Profiles.size(); i++)
+	{
+		if (!m_Configured[i])
+		{
+			UpdateProfile(i, DefaultProfile(i), false);
+		}
+	}
+}
+
+void ColorPipeline::SetColor(uint32_t fixture, const float* rgbi)
+{
+	if (fixture >= COLOR_MAX_FIXTURES)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (fixture >= m_Profiles.size())
+	{
+		Resize(fixture + 1);
+	}
+	m_Red[fixture] = rgbi[0];
+	m_Green[fixture] = rgbi[1];
+	m_Blue[fixture] = rgbi[2];
+	m_Intensity[fixture] = rgbi[3];
+	m_Active[fixture] = 1;
+	m_Changed[fixture] = 1;
+	m_Dirty = true;
+}
+
+void ColorPipeline::SaveColors(ColorState& state)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	size_t count = m_Profiles.size();
+	state.red.assign(m_Red.begin(), m_Red.begin() + count);
+	state.green.assign(m_Green.begin(), m_Green.begin() + count);
+	state.blue.assign(m_Blue.begin(), m_Blue.begin() + count);
+	state.intensity.assign(m_Intensity.begin(), m_Intensity.begin() + count);
+	state.active = m_Active;
+	state.changed = m_Changed;
+}
+
+void ColorPipeline::LoadColors(const ColorState& state)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (state.active.size() > m_Profiles.size())
+	{
+		Resize((uint32_t)state.active.size());
+	}
+
+	m_Dirty = false;
+	for (size_t i = 0; i < m_Profiles.size(); i++)
+	{
+		bool saved = i < state.active.size();
+		m_Red[i] = saved ? state.red[i] : 0.0f;
+		m_Green[i] = saved ? state.green[i] : 0.0f;
+		m_Blue[i] = saved ? state.blue[i] : 0.0f;
+		m_Intensity[i] = saved ? state.intensity[i] : 0.0f;
+		m_Active[i] = saved ? state.active[i] : 0;
+		m_Changed[i] = saved ? state.changed[i] : 0;
+		m_Dirty = m_Dirty || m_Changed[i] != 0;
+	}
+}
+
+void ColorPipeline::Convert()
+{
+	size_t count = m_Red.size();
+	float* channels = m_Channels.data();
+
+#ifdef COLOR_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 intensity = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&m_Intensity[i]), zero), one);
+		__m128 dimmer = _mm_loadu_ps(&m_DimmerMask[i]);
+		// DRGB fixtures dim on their own channel, everything else scales the color
+		__m128 scale = _mm_add_ps(intensity, _mm_mul_ps(dimmer, _mm_sub_ps(one, intensity)));
+
+		__m128 r = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&m_Red[i]), zero), one), _mm_mul_ps(_mm_loadu_ps(&m_GainRed[i]), scale));
+		__m128 g = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&m_Green[i]), zero), one), _mm_mul_ps(_mm_loadu_ps(&m_GainGreen[i]), scale));
+		__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&m_Blue[i]), zero), one), _mm_mul_ps(_mm_loadu_ps(&m_GainBlue[i]), scale));
+
+		// White takes the common part of all three, amber the red + half green part
+		__m128 w = _mm_mul_ps(_mm_min_ps(_mm_min_ps(r, g), b), _mm_loadu_ps(&m_WhiteMask[i]));
+		r = _mm_sub_ps(r, w);
+		g = _mm_sub_ps(g, w);
+		b = _mm_sub_ps(b, w);
+		__m128 a = _mm_mul_ps(_mm_min_ps(r, _mm_mul_ps(g, two)), _mm_loadu_ps(&m_AmberMask[i]));
+		r = _mm_sub_ps(r, a);
+		g = _mm_sub_ps(g, _mm_mul_ps(a, half));
+
+		__m128 extra = _mm_add_ps(_mm_add_ps(w, a), _mm_mul_ps(dimmer, intensity));
+		_MM_TRANSPOSE4_PS(r, g, b, extra);
+		_mm_storeu_ps(channels + i * 4, r);
+		_mm_storeu_ps(channels + i * 4 + 4, g);
+		_mm_storeu_ps(channels + i * 4 + 8, b);
+		_mm_storeu_ps(channels + i * 4 + 12, extra);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		float intensity = m_Intensity[i] < 0.0f ? 0.0f : (m_Intensity[i] > 1.0f ? 1.0f : m_Intensity[i]);
+		float scale = intensity + m_DimmerMask[i] * (1.0f - intensity);
+		float r = fminf(fmaxf(m_Red[i], 0.0f), 1.0f) * m_GainRed[i] * scale;
+		float g = fminf(fmaxf(m_Green[i], 0.0f), 1.0f) * m_GainGreen[i] * scale;
+		float b = fminf(fmaxf(m_Blue[i], 0.0f), 1.0f) * m_GainBlue[i] * scale;
+
+		float w = fminf(fminf(r, g), b) * m_WhiteMask[i];
+		r -= w;
+		g -= w;
+		b -= w;
+		float a = fminf(r, g * 2.0f) * m_AmberMask[i];
+		r -= a;
+		g -= a * 0.5f;
+
+		channels[i * 4] = r;
+		channels[i * 4 + 1] = g;
+		channels[i * 4 + 2] = b;
+		channels[i * 4 + 3] = w + a + m_DimmerMask[i] * intensity;
+	}
+#endif
+}
+
+void ColorPipeline::RunFrame()
+{
+	using namespace std::chrono;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (!m_Dirty)
+	{
+		return;
+	}
+	m_Dirty = false;
+
+	steady_clock::time_point start = steady_clock::now();
+	Convert();
+
+	uint64_t dirty = 0;
+	size_t universeCount;
+	uint8_t* universes = m_Scheduler->BeginWrite(&universeCount);
+	for (size_t i = 0; i < m_Profiles.size(); i++)
+	{
+		const ColorProfile& profile = m_Profiles[i];
+		size_t footprint = GetFootprint(profile);
+		if (!m_Changed[i])
+		{
+			continue;
+		}
+		m_Changed[i] = 0;
+		if (!m_Active[i] || profile.universe >= universeCount || profile.start + footprint > DMX_UNIVERSE_SIZE)
+		{
+			continue;
+		}
+
+		// Slot order: D R G B for DRGB, R G B (W/A) for the rest
+		const float* c = &m_Channels[i * 4];
+		float ordered[4];
+		size_t count = 0;
+		if (profile.mode == COLOR_MODE_DRGB)
+		{
+			ordered[count++] = c[3];
+		}
+		ordered[count++] = c[0];
+		ordered[count++] = c[1];
+		ordered[count++] = c[2];
+		if (profile.mode == COLOR_MODE_RGBW || profile.mode == COLOR_MODE_RGBA)
+		{
+			ordered[count++] = c[3];
+		}
+
+		uint8_t* slots = universes + (size_t)profile.universe * DMX_UNIVERSE_SIZE + profile.start;
+		for (size_t j = 0; j < count; j++)
+		{
+			uint16_t value = Apply(profile.curve, ordered[j]);
+			if (profile.fine)
+			{
+				*slots++ = (uint8_t)(value >> 8);
+				*slots++ = (uint8_t)(value & 0xFF);
+			}
+			else
+			{
+				*slots++ = (uint8_t)((value * 255u + 32767u) / 65535u);
+			}
+		}
+		dirty |= 1ull << profile.universe;
+	}
+	m_Scheduler->EndWrite(dirty);
+
+	m_PassMicros = (uint32_t)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
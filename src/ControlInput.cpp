@@ -0,0 +1,589 @@
+// winsock2.h has to come before anything that pulls in windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "ControlInput.h"
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+static uint64_t NowMicros()
+{
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t ReadU32BE(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Size of the OSC string at 'data' including its padding, 0 if it is not terminated within 'size'
+static size_t OscStringSize(const uint8_t* data, size_t size)
+{
+	const uint8_t* end = (const uint8_t*)memchr(data, 0, size);
+	if (end == nullptr)
+	{
+		return 0;
+	}
+	size_t padded = ((size_t)(end - data) + 4) & ~(size_t)3;
+	return padded <= size ? padded : 0;
+}
+
+// The rest of 'address' after 'prefix' if that is a whole path element, nullptr otherwise
+static const char* MatchPrefix(const char* address, const char* prefix)
+{
+	size_t length = strlen(prefix);
+	if (strncmp(address, prefix, length) != 0 || (address[length] != '/' && address[length] != 0))
+	{
+		return nullptr;
+	}
+	return address + length;
+}
+
+static bool ParseIndex(const char* text, uint32_t* index)
+{
+	uint32_t value = 0;
+	size_t digits = 0;
+	for (; text[digits] >= '0' && text[digits] <= '9'; digits++)
+	{
+		if (digits == 9)
+		{
+			return false;
+		}
+		value = value * 10 + (uint32_t)(text[digits] - '0');
+	}
+	if (digits == 0 || text[digits] != 0)
+	{
+		return false;
+	}
+	*index = value;
+	return true;
+}
+
+static void CopyName(char* name, const char* text)
+{
+	size_t length = 0;
+	while (length < CONTROL_NAME_LENGTH - 1 && text[length] != 0)
+	{
+		name[length] = text[length];
+		length++;
+	}
+	name[length] = 0;
+}
+
+static SOCKET OpenSocket(uint16_t port, bool loopbackOnly)
+{
+	SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+	{
+		return INVALID_SOCKET;
+	}
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	if (bind(sock, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+	return sock;
+}
+
+ControlQueue::ControlQueue() : m_Head(0), m_Tail(0)
+{
+
+}
+
+bool ControlQueue::Push(const ControlEvent& event)
+{
+	uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+	if (tail - m_Head.load(std::memory_order_acquire) >= CONTROL_QUEUE_SIZE)
+	{
+		return false;
+	}
+	m_Events[tail & (CONTROL_QUEUE_SIZE - 1)] = event;
+	m_Tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+bool ControlQueue::Pop(ControlEvent& event)
+{
+	uint32_t head = m_Head.load(std::memory_order_relaxed);
+	if (head == m_Tail.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	event = m_Events[head & (CONTROL_QUEUE_SIZE - 1)];
+	m_Head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+ControlInput::ControlInput(OutputScheduler* scheduler) : m_Scheduler(scheduler), m_Running(false), m_Thread(nullptr), m_OscSocket(INVALID_SOCKET),
+	m_MidiSocket(INVALID_SOCKET), m_MidiStatus(0), m_MidiCount(0), m_MidiClocks(0), m_FrameOldest(0), m_FrameEvents(0), m_Messages(0), m_Invalid(0),
+	m_Dropped(0), m_LatencyLast(0), m_LatencyMax(0), m_LatencyTotal(0), m_LatencyFrames(0), m_LatencyLate(0)
+{
+	memset(m_MidiData, 0, sizeof(m_MidiData));
+}
+
+ControlInput::~ControlInput()
+{
+	Stop();
+}
+
+Result ControlInput::Start(uint16_t oscPort, uint16_t midiPort, bool loopbackOnly)
+{
+	Stop();
+	if (oscPort == 0 && midiPort == 0)
+	{
+		return RESULT_ERROR;
+	}
+
+	SOCKET osc = oscPort != 0 ? OpenSocket(oscPort, loopbackOnly) : INVALID_SOCKET;
+	SOCKET midi = midiPort != 0 ? OpenSocket(midiPort, loopbackOnly) : INVALID_SOCKET;
+	if ((oscPort != 0 && osc == INVALID_SOCKET) || (midiPort != 0 && midi == INVALID_SOCKET))
+	{
+		if (osc != INVALID_SOCKET)
+		{
+			closesocket(osc);
+		}
+		if (midi != INVALID_SOCKET)
+		{
+			closesocket(midi);
+		}
+		return RESULT_ERROR;
+	}
+
+	m_OscSocket = (uintptr_t)osc;
+	m_MidiSocket = (uintptr_t)midi;
+	m_MidiStatus = 0;
+	m_MidiCount = 0;
+	m_MidiClocks = 0;
+	m_Messages = 0;
+	m_Invalid = 0;
+	m_Dropped = 0;
+	ResetLatency();
+
+	m_Running = true;
+	m_Thread = new std::thread(&ControlInput::Run, this);
+	return RESULT_SUCCESS;
+}
+
+void ControlInput::Stop()
+{
+	if (m_Thread == nullptr)
+	{
+		return;
+	}
+
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+
+	if ((SOCKET)m_OscSocket != INVALID_SOCKET)
+	{
+		closesocket((SOCKET)m_OscSocket);
+		m_OscSocket = (uintptr_t)INVALID_SOCKET;
+	}
+	if ((SOCKET)m_MidiSocket != INVALID_SOCKET)
+	{
+		closesocket((SOCKET)m_MidiSocket);
+		m_MidiSocket = (uintptr_t)INVALID_SOCKET;
+	}
+}
+
+void ControlInput::ResetLatency()
+{
+	m_LatencyLast = 0;
+	m_LatencyMax = 0;
+	m_LatencyTotal = 0;
+	m_LatencyFrames = 0;
+	m_LatencyLate = 0;
+}
+
+void ControlInput::Run()
+{
+	uint8_t buffer[CONTROL_MAX_PACKET];
+	SOCKET osc = (SOCKET)m_OscSocket;
+	SOCKET midi = (SOCKET)m_MidiSocket;
+	// Ignored by Winsock, needed by BSD sockets
+	int range = (int)((osc != INVALID_SOCKET && (midi == INVALID_SOCKET || osc > midi)) ? osc : midi) + 1;
+
+	while (m_Running)
+	{
+		fd_set readable;
+		FD_ZERO(&readable);
+		if (osc != INVALID_SOCKET)
+		{
+			FD_SET(osc, &readable);
+		}
+		if (midi != INVALID_SOCKET)
+		{
+			FD_SET(midi, &readable);
+		}
+
+		// Short timeout so Stop() never waits long for the thread
+		timeval timeout = { 0, 100000 };
+		if (select(range, &readable, NULL, NULL, &timeout) <= 0)
+		{
+			continue;
+		}
+
+		uint64_t now = NowMicros();
+		if (osc != INVALID_SOCKET && FD_ISSET(osc, &readable))
+		{
+			int received = recv(osc, (char*)buffer, sizeof(buffer), 0);
+			if (received > 0)
+			{
+				ParseOsc(buffer, (size_t)received, now, 0);
+			}
+		}
+		if (midi != INVALID_SOCKET && FD_ISSET(midi, &readable))
+		{
+			int received = recv(midi, (char*)buffer, sizeof(buffer), 0);
+			if (received > 0)
+			{
+				ParseMidi(buffer, (size_t)received, now);
+			}
+		}
+	}
+}
+
+void ControlInput::Post(ControlEvent& event)
+{
+	m_Messages++;
+	if (!m_Queue.Push(event))
+	{
+		m_Dropped++;
+		return;
+	}
+	m_Scheduler->RequestFrame();
+}
+
+void ControlInput::ParseOsc(const uint8_t* data, size_t size, uint64_t now, int depth)
+{
+	if (size >= 8 && memcmp(data, "#bundle", 8) == 0)
+	{
+		// Tag and time tag, then size-prefixed elements. Time tags are ignored, everything applies now.
+		if (depth >= CONTROL_OSC_MAX_DEPTH || size < 16)
+		{
+			m_Invalid++;
+			return;
+		}
+		size_t offset = 16;
+		while (offset + 4 <= size)
+		{
+			size_t elementSize = ReadU32BE(data + offset);
+			offset += 4;
+			if (elementSize > size - offset)
+			{
+				m_Invalid++;
+				return;
+			}
+			ParseOsc(data + offset, elementSize, now, depth + 1);
+			offset += elementSize;
+		}
+		return;
+	}
+
+	if (!ParseOscMessage(data, size, now))
+	{
+		m_Invalid++;
+	}
+}
+
+bool ControlInput::ParseOscMessage(const uint8_t* data, size_t size, uint64_t now)
+{
+	if (size < 4 || data[0] != '/')
+	{
+		return false;
+	}
+	size_t addressSize = OscStringSize(data, size);
+	if (addressSize == 0)
+	{
+		return false;
+	}
+	const char* address = (const char*)data;
+
+	// Only the first argument is used
+	bool hasNumber = false;
+	bool isInteger = false;
+	float number = 0.0f;
+	const char* text = nullptr;
+	const uint8_t* arguments = data + addressSize;
+	size_t argumentsSize = size - addressSize;
+	if (argumentsSize >= 4 && arguments[0] == ',')
+	{
+		size_t tagsSize = OscStringSize(arguments, argumentsSize);
+		if (tagsSize == 0)
+		{
+			return false;
+		}
+		const uint8_t* value = arguments + tagsSize;
+		size_t valueSize = argumentsSize - tagsSize;
+		switch (arguments[1])
+		{
+		case 'i':
+			if (valueSize < 4)
+			{
+				return false;
+			}
+			number = (float)(int32_t)ReadU32BE(value);
+			hasNumber = true;
+			isInteger = true;
+			break;
+		case 'f':
+		{
+			if (valueSize < 4)
+			{
+				return false;
+			}
+			uint32_t bits = ReadU32BE(value);
+			memcpy(&number, &bits, sizeof(number));
+			// NaN and infinity pass every range check and are undefined behaviour in a cast
+			if (!isfinite(number))
+			{
+				return false;
+			}
+			hasNumber = true;
+			break;
+		}
+		case 's':
+			if (OscStringSize(value, valueSize) == 0)
+			{
+				return false;
+			}
+			text = (const char*)value;
+			break;
+		case 'T':
+			number = 1.0f;
+			hasNumber = true;
+			break;
+		case 'F':
+			hasNumber = true;
+			break;
+		}
+	}
+
+	ControlEvent event = {};
+	event.receivedMicros = now;
+	// Buttons send 1 on press and 0 on release, triggers only fire on the press
+	bool pressed = !hasNumber || number != 0.0f;
+	const char* rest;
+
+	if ((rest = MatchPrefix(address, "/cue")) != nullptr)
+	{
+		const char* name = *rest == '/' ? rest + 1 : text;
+		if (name == nullptr || *name == 0)
+		{
+			return false;
+		}
+		if (!pressed)
+		{
+			return true;
+		}
+		event.type = CONTROL_EVENT_CUE;
+		CopyName(event.name, name);
+	}
+	else if ((rest = MatchPrefix(address, "/scene")) != nullptr)
+	{
+		event.type = CONTROL_EVENT_SCENE;
+		if (*rest == '/')
+		{
+			if (!ParseIndex(rest + 1, &event.index))
+			{
+				return false;
+			}
+			if (!pressed)
+			{
+				return true;
+			}
+		}
+		else if (hasNumber && number >= 0.0f && number < 4294967296.0f)
+		{
+			event.index = (uint32_t)number;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if ((rest = MatchPrefix(address, "/fader")) != nullptr)
+	{
+		if (*rest != '/' || !ParseIndex(rest + 1, &event.index) || !hasNumber)
+		{
+			return false;
+		}
+		float level = isInteger ? number / 255.0f : number;
+		event.type = CONTROL_EVENT_FADER;
+		event.value = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+	}
+	else if ((rest = MatchPrefix(address, "/param")) != nullptr)
+	{
+		if (*rest != '/' || !ParseIndex(rest + 1, &event.index) || !hasNumber)
+		{
+			return false;
+		}
+		float value = isInteger ? number / 255.0f : number;
+		event.type = CONTROL_EVENT_PARAMETER;
+		event.value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	}
+	else if (MatchPrefix(address, "/beat") != nullptr)
+	{
+		if (!pressed)
+		{
+			return true;
+		}
+		event.type = CONTROL_EVENT_BEAT;
+	}
+	else
+	{
+		return false;
+	}
+
+	Post(event);
+	return true;
+}
+
+void ControlInput::ParseMidi(const uint8_t* data, size_t size, uint64_t now)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		uint8_t byte = data[i];
+		if (byte >= 0xF8)
+		{
+			// Real time messages may come between any two bytes
+			if (byte == 0xF8 && ++m_MidiClocks >= CONTROL_MIDI_CLOCKS_PER_BEAT)
+			{
+				m_MidiClocks = 0;
+				ControlEvent event = {};
+				event.type = CONTROL_EVENT_BEAT;
+				event.receivedMicros = now;
+				Post(event);
+			}
+			else if (byte == 0xFA)
+			{
+				m_MidiClocks = 0;
+			}
+			continue;
+		}
+		if (byte >= 0xF0)
+		{
+			// System common and SysEx cancel the running status, their data is skipped
+			m_MidiStatus = 0;
+			m_MidiCount = 0;
+			continue;
+		}
+		if (byte & 0x80)
+		{
+			m_MidiStatus = byte;
+			m_MidiCount = 0;
+			continue;
+		}
+		if (m_MidiStatus == 0)
+		{
+			continue;
+		}
+
+		m_MidiData[m_MidiCount++] = byte;
+		uint8_t type = m_MidiStatus & 0xF0;
+		uint8_t length = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+		if (m_MidiCount == length)
+		{
+			HandleMidi(m_MidiStatus, m_MidiData, now);
+			m_MidiCount = 0;
+		}
+	}
+}
+
+void ControlInput::HandleMidi(uint8_t status, const uint8_t* data, uint64_t now)
+{
+	uint8_t type = status & 0xF0;
+	uint8_t channel = status & 0x0F;
+
+	ControlEvent event = {};
+	event.receivedMicros = now;
+	if (type == 0x90 && data[1] > 0 && channel == 0)
+	{
+		event.type = CONTROL_EVENT_SCENE;
+		event.index = data[0];
+	}
+	else if (type == 0x90 && data[1] > 0 && channel == 1)
+	{
+		event.type = CONTROL_EVENT_CUE;
+		uint8_t note = data[0];
+		size_t length = 0;
+		if (note >= 100)
+		{
+			event.name[length++] = (char)('0' + note / 100);
+		}
+		if (note >= 10)
+		{
+			event.name[length++] = (char)('0' + note / 10 % 10);
+		}
+		event.name[length] = (char)('0' + note % 10);
+	}
+	else if (type == 0xB0 && channel == 0)
+	{
+		event.type = CONTROL_EVENT_FADER;
+		event.index = (uint32_t)data[0] + 1;
+		event.value = data[1] / 127.0f;
+	}
+	else if (type == 0xB0 && channel == 1)
+	{
+		event.type = CONTROL_EVENT_PARAMETER;
+		event.index = data[0];
+		event.value = data[1] / 127.0f;
+	}
+	else
+	{
+		return;
+	}
+	Post(event);
+}
+
+bool ControlInput::Poll(ControlEvent& event)
+{
+	if (!m_Queue.Pop(event))
+	{
+		return false;
+	}
+	if (m_FrameEvents == 0 || event.receivedMicros < m_FrameOldest)
+	{
+		m_FrameOldest = event.receivedMicros;
+	}
+	m_FrameEvents++;
+	return true;
+}
+
+void ControlInput::Discard()
+{
+	ControlEvent event;
+	while (m_Queue.Pop(event))
+	{
+	}
+}
+
+void ControlInput::FrameSent()
+{
+	if (m_FrameEvents == 0)
+	{
+		return;
+	}
+	m_FrameEvents = 0;
+
+	uint64_t latency = NowMicros() - m_FrameOldest;
+	m_LatencyLast = (uint32_t)latency;
+	if (latency > m_LatencyMax)
+	{
+		m_LatencyMax = (uint32_t)latency;
+	}
+	m_LatencyTotal += latency;
+	m_LatencyFrames++;
+	if (latency > 1000000 / m_Scheduler->GetFrameRate())
+	{
+		m_LatencyLate++;
+	}
+}
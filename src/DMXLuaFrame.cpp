@@ -0,0 +1,103 @@
+#include "DMXLuaLib.h"
+#include "ScriptEngine.h"
+
+// The part of the Lua API the frame handlers write through. Kept apart from
+// DMXLuaLib.cpp since it does not touch the Application, so the ScriptEngine can
+// be driven without one (see tests/ScriptEngineBenchmark.cpp).
+
+static thread_local bool dispatching = false;
+static thread_local uint8_t* frameUniverses = nullptr;
+static thread_local const std::vector<ScriptClaim>* frameClaims = nullptr;
+
+static bool IsClaimed(size_t universe, size_t slot)
+{
+	for (const ScriptClaim& claim : *frameClaims)
+	{
+		if (claim.universe == universe && slot >= claim.start && slot < (size_t)claim.start + claim.count)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint8_t ToSlotValue(lua_Number v)
+{
+	return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// DMX_setChannel(universe, channel, value), channel 1-512, only inside handlers
+static int L_DMX_setChannel(lua_State* L)
+{
+	lua_Integer universe = luaL_checkinteger(L, 1);
+	lua_Integer channel = luaL_checkinteger(L, 2);
+	lua_Number value = luaL_checknumber(L, 3);
+	if (frameUniverses == nullptr)
+	{
+		return luaL_error(L, "DMX_setChannel() can only be used inside onFrame/onBeat/onCue handlers");
+	}
+
+	size_t slot = (size_t)(channel - 1);
+	if (universe >= 0 && universe < SCRIPT_MAX_UNIVERSES && channel >= 1 && channel <= DMX_UNIVERSE_SIZE && IsClaimed((size_t)universe, slot))
+	{
+		frameUniverses[universe * DMX_UNIVERSE_SIZE + slot] = ToSlotValue(value);
+	}
+	return 0;
+}
+
+// DMX_setChannels(universe, channel, { v1, v2, ... })
+static int L_DMX_setChannels(lua_State* L)
+{
+	lua_Integer universe = luaL_checkinteger(L, 1);
+	lua_Integer channel = luaL_checkinteger(L, 2);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	if (frameUniverses == nullptr)
+	{
+		return luaL_error(L, "DMX_setChannels() can only be used inside onFrame/onBeat/onCue handlers");
+	}
+	if (universe < 0 || universe >= SCRIPT_MAX_UNIVERSES)
+	{
+		return 0;
+	}
+
+	size_t count = (size_t)lua_rawlen(L, 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t slot = (size_t)(channel - 1) + i;
+		if (channel < 1 || slot >= DMX_UNIVERSE_SIZE)
+		{
+			break;
+		}
+		lua_rawgeti(L, 3, (lua_Integer)(i + 1));
+		if (IsClaimed((size_t)universe, slot))
+		{
+			frameUniverses[universe * DMX_UNIVERSE_SIZE + slot] = ToSlotValue(lua_tonumber(L, -1));
+		}
+		lua_pop(L, 1);
+	}
+	return 0;
+}
+
+void DMXLuaLib::SetDispatching(bool value)
+{
+	dispatching = value;
+}
+
+bool DMXLuaLib::IsDispatching()
+{
+	return dispatching;
+}
+
+void DMXLuaLib::SetFrameTarget(uint8_t* universes, const std::vector<ScriptClaim>* claims)
+{
+	frameUniverses = universes;
+	frameClaims = claims;
+}
+
+void DMXLuaLib::LoadFrameLib(lua_State* L)
+{
+	lua_pushcfunction(L, L_DMX_setChannel);
+	lua_setglobal(L, "DMX_setChannel");
+	lua_pushcfunction(L, L_DMX_setChannels);
+	lua_setglobal(L, "DMX_setChannels");
+}
@@ -1,14 +1,15 @@
 #include "DMXLuaLib.h"
 #include <iostream>
 #include "Application.h"
-#include <chrono>
+#include "ScriptEngine.h"
 #include <thread>
 #include <sstream>
 
-uint64_t timeSinceEpochMillisec() {
-	using namespace std::chrono;
-	return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-}
+// Longest single sleep in wait(), so stopping a script does not wait out the whole delay
+#define WAIT_STEP_MICROS 10000
+// In a simulation a script body is charged this much simulated time per this many instructions
+#define SIMULATION_HOOK_INSTRUCTIONS 100000
+#define SIMULATION_HOOK_MICROS 1000
 
 
 template <typename T>
@@ -25,36 +26,61 @@ double lerp(double a, double b, double f)
 	return a * (1.0 - f) + (b * f);
 }
 
-float colors[4] = {};
+// Each script thread (and the worker running the unclaimed handlers) builds its own color,
+// full brightness until DMX_setBrightness is called
+static thread_local float colors[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+static RealClock realClock;
+static thread_local Clock* waitClock = &realClock;
+static thread_local int waitParticipant = 0;
+
+// Handlers run every frame, logging from there would flood the action list
+static void LogAction(const std::string& action)
+{
+	if (!DMXLuaLib::IsDispatching())
+	{
+		Application::INSTANCE->AddScriptAction(action);
+	}
+}
+
+// Scripts work in 0-255, the color pipeline in 0-1
+static void UpdateColors()
+{
+	float normalized[4];
+	for (int i = 0; i < 4; i++)
+	{
+		normalized[i] = colors[i] / 255.0f;
+	}
+	Application::INSTANCE->UpdateDMXColors(normalized);
+}
 
 static int L_DMX_setColor(lua_State* L)
 {
 	colors[0] = luaL_checknumber(L, 1);
 	colors[1] = luaL_checknumber(L, 2);
 	colors[2] = luaL_checknumber(L, 3);
-	Application::INSTANCE->scriptActions.push_back("Set Colors to: Red: " + ToString(colors[0], 0) + " | Green: " + ToString(colors[1], 0) + " | Blue: " + ToString(colors[2], 0));
-	Application::INSTANCE->UpdateDMXColors(colors);
+	LogAction("Set Colors to: Red: " + ToString(colors[0], 0) + " | Green: " + ToString(colors[1], 0) + " | Blue: " + ToString(colors[2], 0));
+	UpdateColors();
 	return 0;
 }
 
 static int L_DMX_setBrightness(lua_State* L)
 {
 	colors[3] = luaL_checknumber(L, 1);
-	Application::INSTANCE->scriptActions.push_back("Set Brightness to: " + ToString(colors[3], 0));
-	Application::INSTANCE->UpdateDMXColors(colors);
+	LogAction("Set Brightness to: " + ToString(colors[3], 0));
+	UpdateColors();
 	return 0;
 }
 
 static int L_DMX_getChannels(lua_State* L)
 {
-	Application::INSTANCE->scriptActions.push_back("Get Channels");
-	lua_pushnumber(L, Application::INSTANCE->dmxChannels);
+	LogAction("Get Channels");
+	lua_pushnumber(L, Application::INSTANCE->dmxChannels.load());
 	return 1;
 }
 
 static int L_appRunning(lua_State* L)
 {
-	lua_pushboolean(L, Application::INSTANCE->running);
+	lua_pushboolean(L, Application::INSTANCE->running.load());
 	return 1;
 }
 
@@ -67,44 +93,86 @@ static int L_lerp(lua_State* L)
 	return 1;
 }
 
+static int L_getParameter(lua_State* L)
+{
+	lua_Integer index = luaL_checkinteger(L, 1);
+	lua_pushnumber(L, index >= 0 ? Application::INSTANCE->scriptEngine.GetParameter((size_t)index) : 0.0f);
+	return 1;
+}
+
 static int L_wait(lua_State* L)
 {
 	double s = luaL_checknumber(L, 1);
-	Application::INSTANCE->scriptActions.push_back("Wait: " + ToString(s, 2) + "s");
-	uint64_t start = timeSinceEpochMillisec();
+	if (DMXLuaLib::IsDispatching())
+	{
+		return luaL_error(L, "wait() cannot be used inside onFrame/onBeat/onCue handlers");
+	}
+	LogAction("Wait: " + ToString(s, 2) + "s");
+	uint64_t end = waitClock->NowMicros() + (uint64_t)(s > 0.0 ? s * 1000000.0 : 0.0);
 
 	while (Application::INSTANCE->running)
 	{
-		uint64_t now = timeSinceEpochMillisec();
-		if (now - start - (s * 1000) > 0)
+		uint64_t now = waitClock->NowMicros();
+		if (now >= end)
 		{
 			break;
 		}
+		waitClock->SleepUntil(waitParticipant, end - now > WAIT_STEP_MICROS ? now + WAIT_STEP_MICROS : end);
 	}
 	return 0;
 }
 
+static int L_DMX_getUniverses(lua_State* L)
+{
+	lua_pushinteger(L, (lua_Integer)Application::INSTANCE->scheduler.GetUniverseCount());
+	return 1;
+}
+
 static int L_DMX_setId(lua_State* L)
 {
 	int id = luaL_checknumber(L, 1);
-	std::string str;
-	str.push_back(1);
-	str.append(std::to_string(CMD_TARGET_ID));
-	str.push_back(':');
-	str.append(std::to_string(id));
-	str.push_back(';');
-	Application::INSTANCE->comm.WriteString(str);
+	Application::INSTANCE->targetId = id;
+	Application::INSTANCE->SendCommand(CMD_TARGET_ID, std::to_string(id));
 	return 0;
 }
 
+// A body that loops without wait() would hold the virtual clock forever and no frame
+// could run. Its work takes simulated time instead, and it ends when the show does.
+static void L_simulationHook(lua_State* L, lua_Debug* /*debug*/)
+{
+	if (DMXLuaLib::IsDispatching())
+	{
+		return;
+	}
+	if (!Application::INSTANCE->running)
+	{
+		luaL_error(L, "script stopped");
+		return;
+	}
+	waitClock->SleepUntil(waitParticipant, waitClock->NowMicros() + SIMULATION_HOOK_MICROS);
+}
+
+void DMXLuaLib::SetClock(Clock* clock, int participant)
+{
+	waitClock = clock != nullptr ? clock : &realClock;
+	waitParticipant = participant;
+}
+
 void DMXLuaLib::LoadLib(lua_State* L)
 {
+	LoadFrameLib(L);
+	if (waitClock->IsSimulated())
+	{
+		lua_sethook(L, L_simulationHook, LUA_MASKCOUNT, SIMULATION_HOOK_INSTRUCTIONS);
+	}
 	lua_pushcfunction(L, L_appRunning);
 	lua_setglobal(L, "appRunning");
 	lua_pushcfunction(L, L_wait);
 	lua_setglobal(L, "wait");
 	lua_pushcfunction(L, L_lerp);
 	lua_setglobal(L, "lerp");
+	lua_pushcfunction(L, L_getParameter);
+	lua_setglobal(L, "getParameter");
 
 	lua_pushnumber(L, DMX_RGB);
 	lua_setglobal(L, "DMX_RGB");
@@ -119,4 +187,6 @@ void DMXLuaLib::LoadLib(lua_State* L)
 	lua_setglobal(L, "DMX_getChannels");
 	lua_pushcfunction(L, L_DMX_setId);
 	lua_setglobal(L, "DMX_setId");
+	lua_pushcfunction(L, L_DMX_getUniverses);
+	lua_setglobal(L, "DMX_getUniverses");
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "DeviceDiscovery.h"
+#include <windows.h>
+#include <setupapi.h>
+#include <devguid.h>
+#include <regstr.h>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+DeviceDiscovery::DeviceDiscovery(SerialComm* comm, SerialOutput* output, OutputScheduler* scheduler) : m_Comm(comm), m_Output(output), m_Scheduler(scheduler),
+	m_Thread(nullptr), m_Running(false), m_Status(CONN_STATUS_NOT_CONNECTED), m_PortsVersion(0), m_ReconnectCount(0), m_WantConnection(false)
+{
+
+}
+
+DeviceDiscovery::~DeviceDiscovery()
+{
+	Stop();
+}
+
+void DeviceDiscovery::Start(std::function<void()> onConnected)
+{
+	if (m_Thread != nullptr)
+	{
+		return;
+	}
+
+	m_OnConnected = onConnected;
+	m_Running = true;
+	m_Thread = new std::thread(&DeviceDiscovery::Run, this);
+}
+
+void DeviceDiscovery::Stop()
+{
+	if (m_Thread == nullptr)
+	{
+		return;
+	}
+
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+}
+
+void DeviceDiscovery::Connect(const std::string& port)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_WantedPort = port;
+	m_WantConnection = true;
+
+	int expected = CONN_STATUS_NOT_CONNECTED;
+	m_Status.compare_exchange_strong(expected, CONN_STATUS_CONNECTING);
+}
+
+void DeviceDiscovery::Disconnect()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_WantConnection = false;
+}
+
+std::vector<std::string> DeviceDiscovery::GetPorts()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Ports;
+}
+
+bool DeviceDiscovery::OpenPort(const std::string& port)
+{
+	if (m_Comm->Open(SerialComm::GetDevice(port), SERIAL_BAUD_RATE) == RESULT_ERROR)
+	{
+		return false;
+	}
+
+	// Connected before the callback runs, otherwise the replayed commands are dropped
+	m_Output->Clear();
+	m_Status = CONN_STATUS_CONNECTED;
+	m_ReconnectCount++;
+	if (m_OnConnected)
+	{
+		m_OnConnected();
+	}
+	m_Scheduler->AddOutput(m_Output);
+	return true;
+}
+
+void DeviceDiscovery::ClosePort()
+{
+	// RemoveOutput waits for a frame in flight, so the handle is idle when it is closed
+	m_Scheduler->RemoveOutput(m_Output);
+	m_Comm->Close();
+}
+
+void DeviceDiscovery::Run()
+{
+	using namespace std::chrono;
+
+	steady_clock::time_point nextScan = steady_clock::now();
+	steady_clock::time_point nextAttempt = steady_clock::now();
+	uint32_t backoff = DISCOVERY_BACKOFF_MIN_MS;
+
+	while (m_Running)
+	{
+		steady_clock::time_point now = steady_clock::now();
+		int status = m_Status;
+
+		if (now >= nextScan)
+		{
+			std::vector<std::string> ports = EnumeratePorts();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if (ports != m_Ports)
+				{
+					m_Ports.swap(ports);
+					m_PortsVersion++;
+				}
+			}
+			// Rescan quickly while waiting for a device to come back
+			nextScan = now + milliseconds(status == CONN_STATUS_CONNECTING ? DISCOVERY_BACKOFF_MIN_MS : DISCOVERY_POLL_MS);
+		}
+
+		std::string wantedPort;
+		bool wantConnection;
+		bool portPresent;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			wantedPort = m_WantedPort;
+			wantConnection = m_WantConnection;
+			portPresent = std::find(m_Ports.begin(), m_Ports.end(), wantedPort) != m_Ports.end();
+		}
+
+		if (!wantConnection)
+		{
+			if (status == CONN_STATUS_CONNECTED)
+			{
+				ClosePort();
+			}
+			m_Status = CONN_STATUS_NOT_CONNECTED;
+		}
+		else if (status == CONN_STATUS_CONNECTED)
+		{
+			if (m_Output->HasFailed() || !portPresent)
+			{
+				std::cout << "Lost connection to " << wantedPort << ", reconnecting..." << std::endl;
+				ClosePort();
+				m_Status = CONN_STATUS_CONNECTING;
+				backoff = DISCOVERY_BACKOFF_MIN_MS;
+				nextAttempt = now;
+				nextScan = now;
+			}
+		}
+		else if (now >= nextAttempt)
+		{
+			if (!portPresent || !OpenPort(wantedPort))
+			{
+				nextAttempt = now + milliseconds(backoff);
+				backoff = std::min<uint32_t>(backoff * 2, DISCOVERY_BACKOFF_MAX_MS);
+			}
+			else
+			{
+				backoff = DISCOVERY_BACKOFF_MIN_MS;
+			}
+		}
+
+		std::this_thread::sleep_for(milliseconds(10));
+	}
+
+	if (m_Status == CONN_STATUS_CONNECTED)
+	{
+		ClosePort();
+	}
+	m_Status = CONN_STATUS_NOT_CONNECTED;
+}
+
+std::vector<std::string> DeviceDiscovery::EnumeratePorts()
+{
+	std::vector<std::string> ports;
+	HDEVINFO hDevInfo;
+	SP_DEVINFO_DATA DeviceInfoData;
+	char portName[256];  // Buffer to store port names
+
+	// Initialize the structure before using it.
+	DeviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+
+	// Get a list of all connected devices with the COM class GUID
+	hDevInfo = SetupDiGetClassDevs(&GUID_DEVCLASS_PORTS, 0, 0, DIGCF_PRESENT);
+
+	if (hDevInfo == INVALID_HANDLE_VALUE) {
+		std::cerr << "SetupDiGetClassDevs failed." << std::endl;
+		return ports;
+	}
+
+	// Enumerate through the devices to find the Arduino
+	DWORD index = 0;
+	while (SetupDiEnumDeviceInfo(hDevInfo, index, &DeviceInfoData)) {
+		// Get the friendly name of the device
+		if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &DeviceInfoData, SPDRP_FRIENDLYNAME, NULL, (PBYTE)portName, sizeof(portName), NULL)) {
+			// Check if the friendly name contains "Arduino"
+			if (strstr(portName, "Arduino")) {
+				std::string friendlyNameStr(portName);
+				size_t startPos = friendlyNameStr.find("(COM");
+				size_t endPos = friendlyNameStr.find(")");
+				if (startPos != std::string::npos && endPos != std::string::npos && endPos > startPos) {
+					ports.push_back(friendlyNameStr.substr(startPos + 1, endPos - startPos - 1));
+				}
+			}
+		}
+		index++;
+	}
+
+	// Clean up
+	SetupDiDestroyDeviceInfoList(hDevInfo);
+
+	// Keep a stable order so a rescan only counts as a change if the set changed
+	std::sort(ports.begin(), ports.end());
+	return ports;
+}
\ No newline at end of file
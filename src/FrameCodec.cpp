@@ -0,0 +1,276 @@
+#include "FrameCodec.h"
+#include "RecordingOutput.h"
+#include <chrono>
+#include <fstream>
+#include <string.h>
+
+FrameEncoder::FrameEncoder() : m_Previous(DMX_FRAME_MAX_SLOTS, 0), m_Sequence(0), m_SinceKey(0), m_LastSlotCount(0),
+	m_SlotCount(DMX_FRAME_MAX_SLOTS), m_KeyInterval(CODEC_DEFAULT_KEY_INTERVAL), m_Mode(CODEC_MODE_ADAPTIVE), m_ForceKey(true),
+	m_Unchanged(0), m_Bytes(0)
+{
+	for (int i = 0; i < DMX_FRAME_TYPES; i++)
+	{
+		m_Frames[i] = 0;
+		m_Payloads[i].reserve(DMX_FRAME_MAX_PAYLOAD);
+	}
+}
+
+void FrameEncoder::SetSlotCount(uint32_t count)
+{
+	if (count < 1)
+	{
+		count = 1;
+	}
+	if (count > DMX_FRAME_MAX_SLOTS)
+	{
+		count = DMX_FRAME_MAX_SLOTS;
+	}
+	m_SlotCount = count;
+}
+
+void FrameEncoder::ResetStats()
+{
+	for (int i = 0; i < DMX_FRAME_TYPES; i++)
+	{
+		m_Frames[i] = 0;
+	}
+	m_Unchanged = 0;
+	m_Bytes = 0;
+}
+
+static void AppendCount(size_t count, std::string& payload)
+{
+	payload.clear();
+	payload.push_back((char)(count & 0xFF));
+	payload.push_back((char)(count >> 8));
+}
+
+void FrameEncoder::EncodeKey(const uint8_t* slots, size_t count, std::string& payload)
+{
+	AppendCount(count, payload);
+	payload.append((const char*)slots, count);
+}
+
+void FrameEncoder::EncodeBitmap(const uint8_t* slots, const uint8_t* previous, size_t count, std::string& payload)
+{
+	AppendCount(count, payload);
+	size_t bitmap = payload.size();
+	payload.append((count + 7) / 8, '\0');
+	for (size_t i = 0; i < count; i++)
+	{
+		if (slots[i] != previous[i])
+		{
+			payload[bitmap + (i >> 3)] |= (char)(1 << (i & 7));
+			payload.push_back((char)slots[i]);
+		}
+	}
+}
+
+void FrameEncoder::EncodeRle(const uint8_t* slots, const uint8_t* previous, size_t count, std::string& payload)
+{
+	AppendCount(count, payload);
+	size_t position = 0;
+	while (true)
+	{
+		size_t start = position;
+		while (start < count && slots[start] == previous[start])
+		{
+			start++;
+		}
+		if (start >= count)
+		{
+			break;
+		}
+
+		// Short gaps are cheaper to send as values than as a new token
+		size_t last = start;
+		for (size_t i = start + 1; i < count && i - start < DMX_FRAME_MAX_RUN; i++)
+		{
+			if (slots[i] != previous[i])
+			{
+				last = i;
+			}
+			else if (i - last >= CODEC_RLE_MIN_GAP)
+			{
+				break;
+			}
+		}
+
+		size_t skip = start - position;
+		while (skip > DMX_FRAME_MAX_RUN)
+		{
+			payload.push_back((char)DMX_FRAME_MAX_RUN);
+			payload.push_back('\0');
+			skip -= DMX_FRAME_MAX_RUN;
+		}
+		size_t run = last + 1 - start;
+		payload.push_back((char)skip);
+		payload.push_back((char)run);
+		payload.append((const char*)slots + start, run);
+		position = last + 1;
+	}
+}
+
+void FrameEncoder::AppendFrame(int type, uint8_t sequence, const std::string& payload, std::string& out)
+{
+	uint8_t header[5] = { DMX_FRAME_START, (uint8_t)type, sequence, (uint8_t)(payload.size() & 0xFF), (uint8_t)(payload.size() >> 8) };
+	uint8_t checksum = 0;
+	for (size_t i = 1; i < sizeof(header); i++)
+	{
+		checksum += header[i];
+	}
+	for (char c : payload)
+	{
+		checksum += (uint8_t)c;
+	}
+	out.append((const char*)header, sizeof(header));
+	out.append(payload);
+	out.push_back((char)checksum);
+}
+
+int FrameEncoder::Encode(const uint8_t* slots, std::string& out)
+{
+	size_t count = m_SlotCount;
+	m_SinceKey++;
+	bool key = m_ForceKey.exchange(false) || count != m_LastSlotCount || m_SinceKey >= m_KeyInterval;
+	if (!key && memcmp(slots, m_Previous.data(), count) == 0)
+	{
+		m_Unchanged++;
+		return -1;
+	}
+
+	int type = DMX_FRAME_KEY;
+	int mode = m_Mode;
+	if (!key)
+	{
+		switch (mode)
+		{
+		case CODEC_MODE_BITMAP:
+			type = DMX_FRAME_BITMAP;
+			break;
+		case CODEC_MODE_RLE:
+			type = DMX_FRAME_RLE;
+			break;
+		case CODEC_MODE_ADAPTIVE:
+		{
+			// Both deltas are built, they are a few hundred bytes at most
+			EncodeBitmap(slots, m_Previous.data(), count, m_Payloads[DMX_FRAME_BITMAP]);
+			EncodeRle(slots, m_Previous.data(), count, m_Payloads[DMX_FRAME_RLE]);
+			size_t best = 2 + count;
+			for (int candidate = DMX_FRAME_BITMAP; candidate <= DMX_FRAME_RLE; candidate++)
+			{
+				if (m_Payloads[candidate].size() < best)
+				{
+					best = m_Payloads[candidate].size();
+					type = candidate;
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	if (type == DMX_FRAME_KEY)
+	{
+		EncodeKey(slots, count, m_Payloads[DMX_FRAME_KEY]);
+	}
+	else if (mode != CODEC_MODE_ADAPTIVE)
+	{
+		if (type == DMX_FRAME_BITMAP)
+		{
+			EncodeBitmap(slots, m_Previous.data(), count, m_Payloads[type]);
+		}
+		else
+		{
+			EncodeRle(slots, m_Previous.data(), count, m_Payloads[type]);
+		}
+	}
+
+	size_t before = out.size();
+	AppendFrame(type, m_Sequence, m_Payloads[type], out);
+	m_Sequence++;
+	memcpy(m_Previous.data(), slots, count);
+	m_LastSlotCount = count;
+	if (type == DMX_FRAME_KEY)
+	{
+		m_SinceKey = 0;
+	}
+
+	m_Frames[type]++;
+	m_Bytes += out.size() - before;
+	return type;
+}
+
+Result BenchmarkCapture(const std::string& path, uint32_t slotCount, uint32_t keyInterval, uint32_t baudRate, CodecBenchmark results[CODEC_MODE_COUNT])
+{
+	using namespace std::chrono;
+
+	std::ifstream file(path, std::ios::binary);
+	CaptureFileHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != CAPTURE_FILE_MAGIC || header.universeCount == 0)
+	{
+		return RESULT_ERROR;
+	}
+	if (slotCount < 1 || slotCount > DMX_FRAME_MAX_SLOTS)
+	{
+		return RESULT_ERROR;
+	}
+
+	// Only universe 0 goes over the serial line
+	size_t frameSize = (size_t)header.universeCount * DMX_UNIVERSE_SIZE;
+	std::vector<uint8_t> frame(frameSize);
+	std::vector<uint8_t> slots;
+	while (file.read((char*)frame.data(), frameSize))
+	{
+		slots.insert(slots.end(), frame.begin(), frame.begin() + slotCount);
+	}
+	size_t frames = slots.size() / slotCount;
+	if (frames == 0)
+	{
+		return RESULT_ERROR;
+	}
+
+	std::string out;
+	out.reserve(DMX_FRAME_MAX_PAYLOAD + DMX_FRAME_OVERHEAD);
+	for (int mode = 0; mode < CODEC_MODE_COUNT; mode++)
+	{
+		FrameEncoder encoder;
+		encoder.SetSlotCount(slotCount);
+		encoder.SetKeyInterval(keyInterval);
+		encoder.SetMode(mode);
+		DMXFrameDecoder decoder;
+
+		CodecBenchmark& result = results[mode];
+		result = {};
+		result.frames = frames;
+		result.verified = true;
+		nanoseconds encodeTime(0);
+		for (size_t i = 0; i < frames; i++)
+		{
+			const uint8_t* current = slots.data() + i * slotCount;
+			out.clear();
+			steady_clock::time_point start = steady_clock::now();
+			int type = encoder.Encode(current, out);
+			encodeTime += steady_clock::now() - start;
+
+			if (type >= 0)
+			{
+				result.sentFrames++;
+			}
+			result.bytes += out.size();
+			for (char c : out)
+			{
+				decoder.Feed((uint8_t)c);
+			}
+			decoder.frameReady = false;
+			if (decoder.slotCount != slotCount || memcmp(decoder.slots, current, slotCount) != 0)
+			{
+				result.verified = false;
+			}
+		}
+
+		result.encodeMicros = duration<double, std::micro>(encodeTime).count() / frames;
+		result.framesPerSecond = result.bytes > 0 ? (baudRate / 10.0) * frames / result.bytes : 0.0;
+	}
+	return RESULT_SUCCESS;
+}
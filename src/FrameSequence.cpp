@@ -0,0 +1,302 @@
+#include "FrameSequence.h"
+#include <windows.h>
+#include <wincodec.h>
+#include <filesystem>
+#include <string.h>
+
+static uint64_t AllocationGranularity()
+{
+	static uint64_t granularity = 0;
+	if (granularity == 0)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		granularity = info.dwAllocationGranularity;
+	}
+	return granularity;
+}
+
+FrameSequence::FrameSequence() : m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr), m_View(nullptr), m_ViewOffset(0), m_ViewSize(0), m_FileSize(0),
+	m_DataOffset(0), m_FrameSize(0), m_Width(0), m_Height(0), m_FrameCount(0), m_FrameRate(0.0f)
+{
+
+}
+
+FrameSequence::~FrameSequence()
+{
+	Close();
+}
+
+Result FrameSequence::OpenFile(const std::string& path)
+{
+	// Sequential scan lets the cache manager read ahead of the playback position
+	m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_ERROR;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart <= 0)
+	{
+		return RESULT_ERROR;
+	}
+	m_FileSize = (uint64_t)fileSize.QuadPart;
+
+	m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_Mapping == nullptr)
+	{
+		return RESULT_ERROR;
+	}
+	return RESULT_SUCCESS;
+}
+
+Result FrameSequence::MapWindow(uint64_t offset, size_t size)
+{
+	if (m_View != nullptr)
+	{
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+		m_ViewSize = 0;
+	}
+
+	// Views have to start on the allocation granularity
+	uint64_t start = offset - offset % AllocationGranularity();
+	uint64_t length = (offset - start) + size;
+	if (start + length > m_FileSize)
+	{
+		length = m_FileSize - start;
+	}
+
+	m_View = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)(start & 0xFFFFFFFF), (size_t)length);
+	if (m_View == nullptr)
+	{
+		return RESULT_ERROR;
+	}
+	m_ViewOffset = start;
+	m_ViewSize = (size_t)length;
+	return RESULT_SUCCESS;
+}
+
+Result FrameSequence::Open(const std::string& path)
+{
+	Close();
+
+	if (OpenFile(path) == RESULT_ERROR || m_FileSize < sizeof(SequenceFileHeader) || MapWindow(0, sizeof(SequenceFileHeader)) == RESULT_ERROR)
+	{
+		Close();
+		return RESULT_ERROR;
+	}
+
+	SequenceFileHeader header;
+	memcpy(&header, m_View, sizeof(header));
+	uint64_t frameSize = (uint64_t)header.width * header.height * 3;
+	if (header.magic != SEQUENCE_FILE_MAGIC || header.version != SEQUENCE_FILE_VERSION || frameSize == 0 || header.frameCount == 0 ||
+		!(header.frameRate > 0.0f) || sizeof(SequenceFileHeader) + frameSize * header.frameCount > m_FileSize)
+	{
+		Close();
+		return RESULT_ERROR;
+	}
+
+	m_Width = header.width;
+	m_Height = header.height;
+	m_FrameCount = header.frameCount;
+	m_FrameRate = header.frameRate;
+	m_FrameSize = (size_t)frameSize;
+	m_DataOffset = sizeof(SequenceFileHeader);
+	return RESULT_SUCCESS;
+}
+
+Result FrameSequence::OpenRaw(const std::string& path, uint32_t width, uint32_t height, float frameRate)
+{
+	Close();
+
+	uint64_t frameSize = (uint64_t)width * height * 3;
+	if (frameSize == 0 || !(frameRate > 0.0f) || OpenFile(path) == RESULT_ERROR || m_FileSize < frameSize)
+	{
+		Close();
+		return RESULT_ERROR;
+	}
+
+	// A partial frame at the end is ignored
+	m_Width = width;
+	m_Height = height;
+	m_FrameCount = (uint32_t)(m_FileSize / frameSize);
+	m_FrameRate = frameRate;
+	m_FrameSize = (size_t)frameSize;
+	m_DataOffset = 0;
+	return RESULT_SUCCESS;
+}
+
+void FrameSequence::Close()
+{
+	if (m_View != nullptr)
+	{
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+	}
+	if (m_Mapping != nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+	m_ViewOffset = 0;
+	m_ViewSize = 0;
+	m_FileSize = 0;
+	m_FrameSize = 0;
+	m_Width = 0;
+	m_Height = 0;
+	m_FrameCount = 0;
+	m_FrameRate = 0.0f;
+}
+
+const uint8_t* FrameSequence::GetFrame(uint32_t index)
+{
+	if (!IsOpen() || index >= m_FrameCount)
+	{
+		return nullptr;
+	}
+
+	uint64_t offset = m_DataOffset + (uint64_t)index * m_FrameSize;
+	if (m_View == nullptr || offset < m_ViewOffset || offset + m_FrameSize > m_ViewOffset + m_ViewSize)
+	{
+		// Move the window so it starts at this frame, playback mostly runs forward
+		if (MapWindow(offset, m_FrameSize > SEQUENCE_WINDOW_SIZE ? m_FrameSize : SEQUENCE_WINDOW_SIZE) == RESULT_ERROR)
+		{
+			return nullptr;
+		}
+	}
+	return m_View + (offset - m_ViewOffset);
+}
+
+void FrameSequence::Prefetch(uint32_t index)
+{
+	if (m_View == nullptr || index >= m_FrameCount)
+	{
+		return;
+	}
+
+	uint64_t offset = m_DataOffset + (uint64_t)index * m_FrameSize;
+	if (offset < m_ViewOffset || offset + m_FrameSize > m_ViewOffset + m_ViewSize)
+	{
+		return;
+	}
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = m_View + (offset - m_ViewOffset);
+	range.NumberOfBytes = m_FrameSize;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+Result FrameSequence::DecodeImage(const std::string& path, uint32_t* width, uint32_t* height, std::vector<uint8_t>& rgb)
+{
+	IWICImagingFactory* factory = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+	Result result = RESULT_ERROR;
+
+	UINT w = 0;
+	UINT h = 0;
+	std::wstring widePath = std::filesystem::path(path).wstring();
+	if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) &&
+		SUCCEEDED(factory->CreateDecoderFromFilename(widePath.c_str(), NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+		SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat24bppRGB, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom)) &&
+		SUCCEEDED(converter->GetSize(&w, &h)) && w > 0 && h > 0)
+	{
+		rgb.resize((size_t)w * h * 3);
+		if (SUCCEEDED(converter->CopyPixels(NULL, w * 3, (UINT)rgb.size(), rgb.data())))
+		{
+			*width = w;
+			*height = h;
+			result = RESULT_SUCCESS;
+		}
+	}
+
+	if (converter != nullptr)
+	{
+		converter->Release();
+	}
+	if (frame != nullptr)
+	{
+		frame->Release();
+	}
+	if (decoder != nullptr)
+	{
+		decoder->Release();
+	}
+	if (factory != nullptr)
+	{
+		factory->Release();
+	}
+	return result;
+}
+
+Result FrameSequence::Import(const std::vector<std::string>& images, const std::string& path, float frameRate)
+{
+	if (images.empty() || !(frameRate > 0.0f))
+	{
+		return RESULT_ERROR;
+	}
+
+	// Written next to the target and renamed at the end, a failed import leaves no partial file and keeps the old one
+	std::string temporary = path + ".tmp";
+	HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_ERROR;
+	}
+
+	// Header goes first with the final values, only one frame is held in memory at a time
+	SequenceFileHeader header = { SEQUENCE_FILE_MAGIC, SEQUENCE_FILE_VERSION, 0, 0, (uint32_t)images.size(), frameRate };
+	std::vector<uint8_t> rgb;
+	Result result = RESULT_SUCCESS;
+	DWORD written;
+	for (size_t i = 0; i < images.size() && result == RESULT_SUCCESS; i++)
+	{
+		uint32_t width;
+		uint32_t height;
+		if (DecodeImage(images[i], &width, &height, rgb) == RESULT_ERROR)
+		{
+			result = RESULT_ERROR;
+			break;
+		}
+
+		if (i == 0)
+		{
+			header.width = width;
+			header.height = height;
+			if (!WriteFile(file, &header, sizeof(header), &written, NULL) || written != sizeof(header))
+			{
+				result = RESULT_ERROR;
+			}
+		}
+		else if (width != header.width || height != header.height)
+		{
+			result = RESULT_ERROR;
+		}
+
+		if (result == RESULT_SUCCESS && (!WriteFile(file, rgb.data(), (DWORD)rgb.size(), &written, NULL) || written != rgb.size()))
+		{
+			result = RESULT_ERROR;
+		}
+	}
+
+	CloseHandle(file);
+	if (result == RESULT_SUCCESS && !MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		result = RESULT_ERROR;
+	}
+	if (result == RESULT_ERROR)
+	{
+		DeleteFileA(temporary.c_str());
+	}
+	return result;
+}
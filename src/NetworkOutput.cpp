@@ -0,0 +1,229 @@
+// winsock2.h has to come before anything that pulls in windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "NetworkOutput.h"
+#include <random>
+#include <string.h>
+
+static const uint8_t ARTNET_ID[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+static const uint8_t SACN_ACN_ID[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+
+static void WriteU16BE(uint8_t* p, uint16_t v)
+{
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)(v & 0xFF);
+}
+
+static void WriteU32BE(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)((v >> 16) & 0xFF);
+	p[2] = (uint8_t)((v >> 8) & 0xFF);
+	p[3] = (uint8_t)(v & 0xFF);
+}
+
+Result NetworkOutput::InitNetwork()
+{
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		return RESULT_ERROR;
+	}
+	return RESULT_SUCCESS;
+}
+
+void NetworkOutput::ShutdownNetwork()
+{
+	WSACleanup();
+}
+
+NetworkOutput::NetworkOutput() : m_Open(false), m_Socket(INVALID_SOCKET), m_Protocol(NET_PROTOCOL_ARTNET), m_Port(ARTNET_PORT),
+	m_FirstUniverse(0), m_UniverseCount(0), m_PacketSize(0), m_Sequence(0), m_PacketsSent(0), m_SendErrors(0)
+{
+
+}
+
+NetworkOutput::~NetworkOutput()
+{
+	if (m_Open)
+	{
+		Close();
+	}
+}
+
+Result NetworkOutput::Open(int protocol, const std::string& host, size_t universeCount, uint16_t firstUniverse)
+{
+	if (m_Open)
+	{
+		Close();
+	}
+	if (universeCount < 1 || universeCount > NET_MAX_UNIVERSES)
+	{
+		return RESULT_ERROR;
+	}
+
+	SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+	{
+		return RESULT_ERROR;
+	}
+
+	BOOL broadcast = TRUE;
+	setsockopt(sock, SOL_SOCKET, SO_BROADCAST, (const char*)&broadcast, sizeof(broadcast));
+	int sendBuffer = (int)(universeCount * (SACN_HEADER_SIZE + DMX_UNIVERSE_SIZE) * 4);
+	setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&sendBuffer, sizeof(sendBuffer));
+
+	in_addr hostAddress = {};
+	if (!host.empty() && inet_pton(AF_INET, host.c_str(), &hostAddress) != 1)
+	{
+		closesocket(sock);
+		return RESULT_ERROR;
+	}
+
+	m_Protocol = protocol;
+	m_Port = GetPort(protocol);
+	m_FirstUniverse = firstUniverse;
+	m_UniverseCount = universeCount;
+	m_PacketSize = GetHeaderSize(protocol) + DMX_UNIVERSE_SIZE;
+	m_Packets.assign(m_PacketSize * universeCount, 0);
+	m_Destinations.resize(universeCount);
+	m_Sequence = 0;
+	m_PacketsSent = 0;
+	m_SendErrors = 0;
+
+	uint8_t cid[16];
+	std::random_device random;
+	for (size_t i = 0; i < sizeof(cid); i++)
+	{
+		cid[i] = (uint8_t)random();
+	}
+
+	for (size_t i = 0; i < universeCount; i++)
+	{
+		uint16_t universe = (uint16_t)(firstUniverse + i);
+		uint8_t* packet = m_Packets.data() + i * m_PacketSize;
+
+		if (protocol == NET_PROTOCOL_SACN)
+		{
+			BuildSACNHeader(packet, universe, cid);
+			// 239.255.<universe hi>.<universe lo>
+			m_Destinations[i] = host.empty() ? htonl(0xEFFF0000 | universe) : hostAddress.s_addr;
+		}
+		else
+		{
+			BuildArtNetHeader(packet, universe);
+			m_Destinations[i] = host.empty() ? htonl(INADDR_BROADCAST) : hostAddress.s_addr;
+		}
+	}
+
+	m_Socket = (uintptr_t)sock;
+	m_Open = true;
+	return RESULT_SUCCESS;
+}
+
+Result NetworkOutput::Close()
+{
+	if (m_Socket != (uintptr_t)INVALID_SOCKET)
+	{
+		closesocket((SOCKET)m_Socket);
+	}
+	m_Socket = (uintptr_t)INVALID_SOCKET;
+	m_Open = false;
+
+	return RESULT_SUCCESS;
+}
+
+void NetworkOutput::BuildArtNetHeader(uint8_t* packet, uint16_t universe)
+{
+	memcpy(packet, ARTNET_ID, sizeof(ARTNET_ID));
+	packet[8] = ARTNET_OPCODE_DMX & 0xFF;        // OpCode, little endian
+	packet[9] = ARTNET_OPCODE_DMX >> 8;
+	WriteU16BE(packet + 10, ARTNET_PROTOCOL_VERSION);
+	packet[12] = 0;                               // Sequence, patched per frame
+	packet[13] = 0;                               // Physical
+	packet[14] = (uint8_t)(universe & 0xFF);      // SubUni
+	packet[15] = (uint8_t)((universe >> 8) & 0x7F); // Net
+	WriteU16BE(packet + 16, DMX_UNIVERSE_SIZE);
+}
+
+void NetworkOutput::BuildSACNHeader(uint8_t* packet, uint16_t universe, const uint8_t* cid)
+{
+	const uint16_t size = SACN_HEADER_SIZE + DMX_UNIVERSE_SIZE;
+
+	// Root layer
+	WriteU16BE(packet + 0, 0x0010);
+	WriteU16BE(packet + 2, 0x0000);
+	memcpy(packet + 4, SACN_ACN_ID, sizeof(SACN_ACN_ID));
+	WriteU16BE(packet + 16, 0x7000 | (size - 16));
+	WriteU32BE(packet + 18, 0x00000004);
+	memcpy(packet + 22, cid, 16);
+
+	// Framing layer
+	WriteU16BE(packet + 38, 0x7000 | (size - 38));
+	WriteU32BE(packet + 40, 0x00000002);
+	memcpy(packet + 44, SACN_SOURCE_NAME, sizeof(SACN_SOURCE_NAME));
+	packet[108] = SACN_DEFAULT_PRIORITY;
+	WriteU16BE(packet + 109, 0);                  // Synchronization address
+	packet[111] = 0;                              // Sequence, patched per frame
+	packet[112] = 0;                              // Options
+	WriteU16BE(packet + 113, universe);
+
+	// DMP layer
+	WriteU16BE(packet + 115, 0x7000 | (size - 115));
+	packet[117] = 0x02;
+	packet[118] = 0xA1;
+	WriteU16BE(packet + 119, 0x0000);
+	WriteU16BE(packet + 121, 0x0001);
+	WriteU16BE(packet + 123, DMX_UNIVERSE_SIZE + 1);
+	packet[125] = 0;                              // Start code
+}
+
+Result NetworkOutput::SendFrame(const uint8_t* universes, size_t universeCount)
+{
+	if (!m_Open)
+	{
+		return RESULT_ERROR;
+	}
+
+	m_Sequence++;
+	if (m_Protocol == NET_PROTOCOL_ARTNET && m_Sequence == 0)
+	{
+		// Art-Net reserves 0 for "sequencing disabled"
+		m_Sequence = 1;
+	}
+
+	size_t count = universeCount < m_UniverseCount ? universeCount : m_UniverseCount;
+	size_t headerSize = GetHeaderSize(m_Protocol);
+	size_t sequenceOffset = m_Protocol == NET_PROTOCOL_SACN ? 111 : 12;
+
+	// Patch every packet first, then push them out back to back so the whole
+	// batch leaves in one burst instead of being interleaved with the copies
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t* packet = m_Packets.data() + i * m_PacketSize;
+		packet[sequenceOffset] = m_Sequence;
+		memcpy(packet + headerSize, universes + i * DMX_UNIVERSE_SIZE, DMX_UNIVERSE_SIZE);
+	}
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(m_Port);
+
+	Result result = RESULT_SUCCESS;
+	for (size_t i = 0; i < count; i++)
+	{
+		address.sin_addr.s_addr = m_Destinations[i];
+		int sent = sendto((SOCKET)m_Socket, (const char*)m_Packets.data() + i * m_PacketSize, (int)m_PacketSize, 0, (const sockaddr*)&address, sizeof(address));
+		if (sent != (int)m_PacketSize)
+		{
+			m_SendErrors++;
+			result = RESULT_ERROR;
+		}
+		else
+		{
+			m_PacketsSent++;
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
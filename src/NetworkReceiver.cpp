@@ -0,0 +1,162 @@
+// winsock2.h has to come before anything that pulls in windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "NetworkReceiver.h"
+#include <string.h>
+
+static uint16_t ReadU16BE(const uint8_t* p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t ReadU32BE(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+NetworkReceiver::NetworkReceiver() : m_Running(false), m_Thread(nullptr), m_Socket(INVALID_SOCKET), m_Protocol(NET_PROTOCOL_ARTNET),
+	m_Packets(0), m_Bytes(0), m_Invalid(0), m_SequenceErrors(0)
+{
+	memset(m_LastSequence, 0, sizeof(m_LastSequence));
+	memset(m_SeenUniverse, 0, sizeof(m_SeenUniverse));
+}
+
+NetworkReceiver::~NetworkReceiver()
+{
+	Stop();
+}
+
+Result NetworkReceiver::Start(int protocol)
+{
+	Stop();
+
+	SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+	{
+		return RESULT_ERROR;
+	}
+
+	// Short timeout so Stop() never waits long for the thread
+	DWORD timeout = 100;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	int receiveBuffer = 4 * 1024 * 1024;
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBuffer, sizeof(receiveBuffer));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(NetworkOutput::GetPort(protocol));
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(sock, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		closesocket(sock);
+		return RESULT_ERROR;
+	}
+
+	m_Protocol = protocol;
+	m_Packets = 0;
+	m_Bytes = 0;
+	m_Invalid = 0;
+	m_SequenceErrors = 0;
+	memset(m_SeenUniverse, 0, sizeof(m_SeenUniverse));
+
+	m_Socket = (uintptr_t)sock;
+	m_Running = true;
+	m_Thread = new std::thread(&NetworkReceiver::Run, this);
+	return RESULT_SUCCESS;
+}
+
+void NetworkReceiver::Stop()
+{
+	if (m_Thread == nullptr)
+	{
+		return;
+	}
+
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+
+	closesocket((SOCKET)m_Socket);
+	m_Socket = (uintptr_t)INVALID_SOCKET;
+}
+
+void NetworkReceiver::Run()
+{
+	uint8_t buffer[SACN_HEADER_SIZE + DMX_UNIVERSE_SIZE + 64];
+
+	while (m_Running)
+	{
+		int received = recv((SOCKET)m_Socket, (char*)buffer, sizeof(buffer), 0);
+		if (received <= 0)
+		{
+			continue;
+		}
+
+		uint16_t universe;
+		uint8_t sequence;
+		if (!Validate(m_Protocol, buffer, (size_t)received, &universe, &sequence))
+		{
+			m_Invalid++;
+			continue;
+		}
+
+		m_Packets++;
+		m_Bytes += received;
+
+		size_t index = universe % NET_MAX_UNIVERSES;
+		if (m_SeenUniverse[index])
+		{
+			uint8_t expected = (uint8_t)(m_LastSequence[index] + 1);
+			if (m_Protocol == NET_PROTOCOL_ARTNET && expected == 0)
+			{
+				expected = 1;
+			}
+			if (sequence != expected)
+			{
+				m_SequenceErrors++;
+			}
+		}
+		m_SeenUniverse[index] = true;
+		m_LastSequence[index] = sequence;
+	}
+}
+
+bool NetworkReceiver::Validate(int protocol, const uint8_t* packet, size_t size, uint16_t* universe, uint8_t* sequence)
+{
+	if (protocol == NET_PROTOCOL_SACN)
+	{
+		static const uint8_t acnId[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+
+		if (size < SACN_HEADER_SIZE) return false;
+		if (ReadU16BE(packet) != 0x0010) return false;
+		if (memcmp(packet + 4, acnId, sizeof(acnId)) != 0) return false;
+		if ((ReadU16BE(packet + 16) & 0x0FFF) != size - 16) return false;
+		if (ReadU32BE(packet + 18) != 0x00000004) return false;
+		if ((ReadU16BE(packet + 38) & 0x0FFF) != size - 38) return false;
+		if (ReadU32BE(packet + 40) != 0x00000002) return false;
+		if ((ReadU16BE(packet + 115) & 0x0FFF) != size - 115) return false;
+		if (packet[117] != 0x02 || packet[118] != 0xA1) return false;
+
+		uint16_t count = ReadU16BE(packet + 123);
+		if (count < 1 || count > DMX_UNIVERSE_SIZE + 1 || size != (size_t)(SACN_HEADER_SIZE - 1 + count)) return false;
+
+		*universe = ReadU16BE(packet + 113);
+		*sequence = packet[111];
+		return true;
+	}
+
+	static const uint8_t artNetId[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+
+	if (size < ARTNET_HEADER_SIZE) return false;
+	if (memcmp(packet, artNetId, sizeof(artNetId)) != 0) return false;
+	if ((packet[8] | (packet[9] << 8)) != ARTNET_OPCODE_DMX) return false;
+	if (ReadU16BE(packet + 10) < ARTNET_PROTOCOL_VERSION) return false;
+
+	uint16_t length = ReadU16BE(packet + 16);
+	if (length < 2 || length > DMX_UNIVERSE_SIZE || size < (size_t)(ARTNET_HEADER_SIZE + length)) return false;
+
+	*universe = (uint16_t)(((packet[15] & 0x7F) << 8) | packet[14]);
+	*sequence = packet[12];
+	return true;
+}
\ No newline at end of file
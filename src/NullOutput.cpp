@@ -0,0 +1,28 @@
+#include "NullOutput.h"
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+NullOutput::NullOutput() : m_FrameCount(0), m_Checksum(FNV_OFFSET_BASIS)
+{
+
+}
+
+void NullOutput::Reset()
+{
+	m_FrameCount = 0;
+	m_Checksum = FNV_OFFSET_BASIS;
+}
+
+Result NullOutput::SendFrame(const uint8_t* universes, size_t universeCount)
+{
+	uint64_t hash = m_Checksum.load(std::memory_order_relaxed);
+	size_t size = universeCount * DMX_UNIVERSE_SIZE;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ universes[i]) * FNV_PRIME;
+	}
+	m_Checksum = hash;
+	m_FrameCount++;
+	return RESULT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+#include "OutputScheduler.h"
+#include <algorithm>
+#include <string.h>
+
+#define OUTPUT_READY_FRESH 0x4u
+#define OUTPUT_READY_INDEX 0x3u
+
+OutputScheduler::OutputScheduler(Clock* clock) : m_BackIndex(0), m_FrontIndex(2), m_Ready(1), m_UniverseCount(1),
+	m_FrameRequested(false), m_Thread(nullptr), m_Running(false), m_FrameCount(0), m_LastFrameMicros(0), m_FrameRate(OUTPUT_DEFAULT_FPS), m_FrameLimit(0), m_Clock(clock), m_ClockParticipant(0)
+{
+	// Everything is sized for the maximum up front, so the output thread never sees a reallocation
+	m_Working.assign(DMX_MAX_UNIVERSES * DMX_UNIVERSE_SIZE, 0);
+	for (size_t i = 0; i < OUTPUT_BUFFER_COUNT; i++)
+	{
+		m_Buffers[i].assign(DMX_MAX_UNIVERSES * DMX_UNIVERSE_SIZE, 0);
+		m_BufferCounts[i] = 1;
+		m_BufferDirty[i] = 0;
+	}
+}
+
+OutputScheduler::~OutputScheduler()
+{
+	Stop();
+}
+
+void OutputScheduler::Start(uint32_t frameRate, uint64_t frameLimit)
+{
+	if (m_Thread != nullptr)
+	{
+		return;
+	}
+
+	m_FrameRate = frameRate > 0 ? frameRate : OUTPUT_DEFAULT_FPS;
+	m_FrameLimit = frameLimit;
+	m_LastFrameMicros = m_Clock.load()->NowMicros();
+	m_ClockParticipant = m_Clock.load()->Attach();
+	m_Running = true;
+	m_Thread = new std::thread(&OutputScheduler::Run, this);
+}
+
+void OutputScheduler::Stop()
+{
+	if (m_Thread == nullptr)
+	{
+		return;
+	}
+
+	m_Running = false;
+	m_Thread->join();
+	delete m_Thread;
+	m_Thread = nullptr;
+}
+
+void OutputScheduler::RequestFrame()
+{
+	Clock* clock = m_Clock;
+	if (clock->IsSimulated())
+	{
+		return;
+	}
+	m_FrameRequested = true;
+	if (m_Running)
+	{
+		clock->Interrupt(m_ClockParticipant);
+	}
+}
+
+void OutputScheduler::SetClock(Clock* clock)
+{
+	if (m_Thread == nullptr)
+	{
+		m_Clock = clock;
+	}
+}
+
+void OutputScheduler::SetUniverseCount(size_t count)
+{
+	if (count < 1)
+	{
+		count = 1;
+	}
+	if (count > DMX_MAX_UNIVERSES)
+	{
+		count = DMX_MAX_UNIVERSES;
+	}
+
+	std::lock_guard<std::mutex> lock(m_WriteMutex);
+	m_UniverseCount = count;
+	Publish(OUTPUT_ALL_UNIVERSES);
+}
+
+void OutputScheduler::SetChannels(size_t universe, size_t start, const uint8_t* values, size_t count)
+{
+	if (start >= DMX_UNIVERSE_SIZE)
+	{
+		return;
+	}
+	count = std::min(count, DMX_UNIVERSE_SIZE - start);
+
+	std::lock_guard<std::mutex> lock(m_WriteMutex);
+	if (universe >= m_UniverseCount)
+	{
+		return;
+	}
+	memcpy(m_Working.data() + universe * DMX_UNIVERSE_SIZE + start, values, count);
+	Publish(1ull << universe);
+}
+
+void OutputScheduler::GetChannels(size_t universe, size_t start, uint8_t* values, size_t count)
+{
+	if (start >= DMX_UNIVERSE_SIZE)
+	{
+		return;
+	}
+	count = std::min(count, DMX_UNIVERSE_SIZE - start);
+
+	std::lock_guard<std::mutex> lock(m_WriteMutex);
+	if (universe >= m_UniverseCount)
+	{
+		return;
+	}
+	memcpy(values, m_Working.data() + universe * DMX_UNIVERSE_SIZE + start, count);
+}
+
+uint8_t* OutputScheduler::BeginWrite(size_t* universeCount)
+{
+	m_WriteMutex.lock();
+	*universeCount = m_UniverseCount;
+	return m_Working.data();
+}
+
+void OutputScheduler::EndWrite(uint64_t dirtyUniverses)
+{
+	if (dirtyUniverses != 0)
+	{
+		Publish(dirtyUniverses);
+	}
+	m_WriteMutex.unlock();
+}
+
+void OutputScheduler::Publish(uint64_t dirtyUniverses)
+{
+	for (size_t i = 0; i < OUTPUT_BUFFER_COUNT; i++)
+	{
+		m_BufferDirty[i] |= dirtyUniverses;
+	}
+
+	// The back buffer only misses what changed since it was last published, which
+	// is usually the one universe this write touched
+	size_t count = m_UniverseCount;
+	uint64_t dirty = m_BufferDirty[m_BackIndex];
+	uint8_t* back = m_Buffers[m_BackIndex].data();
+	for (size_t u = 0; u < count; u++)
+	{
+		if (dirty & (1ull << u))
+		{
+			memcpy(back + u * DMX_UNIVERSE_SIZE, m_Working.data() + u * DMX_UNIVERSE_SIZE, DMX_UNIVERSE_SIZE);
+		}
+	}
+	m_BufferDirty[m_BackIndex] = 0;
+	m_BufferCounts[m_BackIndex] = count;
+
+	uint32_t previous = m_Ready.exchange((uint32_t)m_BackIndex | OUTPUT_READY_FRESH, std::memory_order_acq_rel);
+	m_BackIndex = previous & OUTPUT_READY_INDEX;
+}
+
+void OutputScheduler::AddOutput(DMXOutput* output)
+{
+	std::lock_guard<std::mutex> lock(m_OutputMutex);
+	if (std::find(m_Outputs.begin(), m_Outputs.end(), output) == m_Outputs.end())
+	{
+		m_Outputs.push_back(output);
+	}
+}
+
+void OutputScheduler::RemoveOutput(DMXOutput* output)
+{
+	std::lock_guard<std::mutex> lock(m_OutputMutex);
+	m_Outputs.erase(std::remove(m_Outputs.begin(), m_Outputs.end(), output), m_Outputs.end());
+}
+
+void OutputScheduler::Run()
+{
+	const uint64_t frameTime = 1000000 / m_FrameRate;
+	Clock* clock = m_Clock;
+	const int participant = m_ClockParticipant;
+	// A request left over from before a switch to the virtual clock must not shift its frames
+	const bool early = !clock->IsSimulated();
+	clock->SleepUntil(participant, clock->NowMicros());
+	uint64_t next = clock->NowMicros();
+	uint64_t last = next;
+	uint64_t frames = 0;
+
+	while (m_Running)
+	{
+		next += frameTime;
+
+		uint64_t start = clock->NowMicros();
+		// Cleared before the callback takes its input, anything later asks for another frame
+		m_FrameRequested = false;
+		if (m_FrameCallback)
+		{
+			m_FrameCallback((start - last) / 1000000.0);
+		}
+		last = start;
+		m_LastFrameMicros = start;
+
+		if (m_Ready.load(std::memory_order_relaxed) & OUTPUT_READY_FRESH)
+		{
+			// Hand the old front back to the writers and take the latest publish
+			m_FrontIndex = m_Ready.exchange((uint32_t)m_FrontIndex, std::memory_order_acq_rel) & OUTPUT_READY_INDEX;
+		}
+		const uint8_t* frame = m_Buffers[m_FrontIndex].data();
+		size_t count = m_BufferCounts[m_FrontIndex];
+
+		{
+			std::lock_guard<std::mutex> lock(m_OutputMutex);
+			for (DMXOutput* output : m_Outputs)
+			{
+				output->SendFrame(frame, count);
+			}
+		}
+		if (m_FrameSentCallback)
+		{
+			m_FrameSentCallback();
+		}
+
+		m_FrameCount++;
+		if (m_FrameLimit > 0 && ++frames >= m_FrameLimit)
+		{
+			if (m_LimitCallback)
+			{
+				m_LimitCallback();
+			}
+			m_Running = false;
+			break;
+		}
+
+		uint64_t now = clock->NowMicros();
+		if (now > next + frameTime)
+		{
+			// We fell more than a frame behind (slow port, debugger), don't try to catch up
+			next = now;
+		}
+
+		uint64_t earliest = start + frameTime / OUTPUT_EARLY_FRAME_DIVISOR;
+		while (m_Running)
+		{
+			uint64_t wake = early && m_FrameRequested && earliest < next ? earliest : next;
+			now = clock->NowMicros();
+			if (now >= wake)
+			{
+				break;
+			}
+			clock->SleepUntil(participant, wake);
+		}
+		if (now < next)
+		{
+			// Early frame, the regular cadence continues from here
+			next = now;
+		}
+	}
+	clock->Detach(participant);
+}
\ No newline at end of file
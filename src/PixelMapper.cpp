@@ -0,0 +1,373 @@
+#include "PixelMapper.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PIXEL_SSE2
+#include <emmintrin.h>
+#endif
+
+PixelMapper::PixelMapper(OutputScheduler* scheduler) : m_Scheduler(scheduler), m_SampleWidth(0), m_SampleHeight(0), m_Position(0.0),
+	m_Playing(false), m_Loop(true), m_Gamma(PIXEL_DEFAULT_GAMMA), m_Brightness(1.0f), m_FrameIndex(0), m_FrameCount(0), m_RenderMicros(0)
+{
+
+}
+
+void PixelMapper::SetFixtures(const std::vector<PixelFixture>& fixtures)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Fixtures.assign(fixtures.begin(), fixtures.size() > PIXEL_MAX_FIXTURES ? fixtures.begin() + PIXEL_MAX_FIXTURES : fixtures.end());
+	m_Colors.assign(m_Fixtures.size() * 4, 0.0f);
+	m_Values.assign(m_Fixtures.size() * 4, 0);
+	// Rebuilt on the next frame
+	m_SampleWidth = 0;
+	m_SampleHeight = 0;
+}
+
+size_t PixelMapper::GetFixtureCount()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Fixtures.size();
+}
+
+std::vector<PixelFixture> PixelMapper::LayoutGrid(uint32_t columns, uint32_t rows, uint16_t universe, uint16_t start, uint8_t channels, bool serpentine)
+{
+	std::vector<PixelFixture> fixtures;
+	if (channels != PIXEL_LAYOUT_RGB && channels != PIXEL_LAYOUT_DRGB)
+	{
+		channels = PIXEL_LAYOUT_RGB;
+	}
+
+	size_t slot = (size_t)universe * DMX_UNIVERSE_SIZE + (start < DMX_UNIVERSE_SIZE ? start : 0);
+	for (uint32_t row = 0; row < rows; row++)
+	{
+		for (uint32_t i = 0; i < columns; i++)
+		{
+			uint32_t column = serpentine && row % 2 == 1 ? columns - 1 - i : i;
+			if (slot % DMX_UNIVERSE_SIZE + channels > DMX_UNIVERSE_SIZE)
+			{
+				slot += DMX_UNIVERSE_SIZE - slot % DMX_UNIVERSE_SIZE;
+			}
+			if (slot / DMX_UNIVERSE_SIZE >= DMX_MAX_UNIVERSES || fixtures.size() >= PIXEL_MAX_FIXTURES)
+			{
+				return fixtures;
+			}
+
+			PixelFixture fixture;
+			fixture.x = columns > 1 ? (float)column / (columns - 1) : 0.5f;
+			fixture.y = rows > 1 ? (float)row / (rows - 1) : 0.5f;
+			fixture.universe = (uint16_t)(slot / DMX_UNIVERSE_SIZE);
+			fixture.start = (uint16_t)(slot % DMX_UNIVERSE_SIZE);
+			fixture.channels = channels;
+			fixtures.push_back(fixture);
+			slot += channels;
+		}
+	}
+	return fixtures;
+}
+
+Result PixelMapper::LoadLayout(const std::string& path, std::vector<PixelFixture>& fixtures)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return RESULT_ERROR;
+	}
+
+	fixtures.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream stream(line);
+		float x;
+		float y;
+		int universe;
+		int channel;
+		if (!(stream >> x))
+		{
+			// Empty line
+			continue;
+		}
+		if (!(stream >> y >> universe >> channel))
+		{
+			return RESULT_ERROR;
+		}
+		int channels = PIXEL_LAYOUT_RGB;
+		stream >> channels;
+
+		if (universe < 0 || universe >= DMX_MAX_UNIVERSES || channel < 1 || (channels != PIXEL_LAYOUT_RGB && channels != PIXEL_LAYOUT_DRGB) ||
+			channel - 1 + channels > DMX_UNIVERSE_SIZE)
+		{
+			return RESULT_ERROR;
+		}
+
+		PixelFixture fixture;
+		fixture.x = x;
+		fixture.y = y;
+		fixture.universe = (uint16_t)universe;
+		fixture.start = (uint16_t)(channel - 1);
+		fixture.channels = (uint8_t)channels;
+		fixtures.push_back(fixture);
+	}
+	return RESULT_SUCCESS;
+}
+
+Result PixelMapper::OpenSequence(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Position = 0.0;
+	Result result = m_Sequence.Open(path);
+	m_FrameCount = m_Sequence.GetFrameCount();
+	return result;
+}
+
+Result PixelMapper::OpenRawSequence(const std::string& path, uint32_t width, uint32_t height, float frameRate)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Position = 0.0;
+	Result result = m_Sequence.OpenRaw(path, width, height, frameRate);
+	m_FrameCount = m_Sequence.GetFrameCount();
+	return result;
+}
+
+void PixelMapper::CloseSequence()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Sequence.Close();
+	m_FrameCount = 0;
+	m_FrameIndex = 0;
+}
+
+void PixelMapper::Rewind()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Position = 0.0;
+}
+
+double PixelMapper::GetPosition()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Position;
+}
+
+void PixelMapper::SetPosition(double position)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Position = position > 0.0 ? position : 0.0;
+}
+
+static float Clamp01(float v)
+{
+	return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+void PixelMapper::BuildSamples(uint32_t width, uint32_t height)
+{
+	m_Samples.resize(m_Fixtures.size());
+	for (size_t i = 0; i < m_Fixtures.size(); i++)
+	{
+		float px = Clamp01(m_Fixtures[i].x) * (width - 1);
+		float py = Clamp01(m_Fixtures[i].y) * (height - 1);
+		uint32_t x0 = (uint32_t)px;
+		uint32_t y0 = (uint32_t)py;
+		uint32_t x1 = x0 + 1 < width ? x0 + 1 : x0;
+		uint32_t y1 = y0 + 1 < height ? y0 + 1 : y0;
+		float fx = px - x0;
+		float fy = py - y0;
+
+		PixelSample& sample = m_Samples[i];
+		sample.offsets[0] = (y0 * width + x0) * 3;
+		sample.offsets[1] = (y0 * width + x1) * 3;
+		sample.offsets[2] = (y1 * width + x0) * 3;
+		sample.offsets[3] = (y1 * width + x1) * 3;
+		sample.weights[0] = (1.0f - fx) * (1.0f - fy);
+		sample.weights[1] = fx * (1.0f - fy);
+		sample.weights[2] = (1.0f - fx) * fy;
+		sample.weights[3] = fx * fy;
+	}
+	m_SampleWidth = width;
+	m_SampleHeight = height;
+}
+
+#ifdef PIXEL_SSE2
+// Three bytes of a pixel as (r, g, b, 0). Loads exactly 3 bytes, the last pixel sits at the end of the mapping.
+static inline __m128 LoadPixel(const uint8_t* p)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_cvtsi32_si128((int)(p[0] | (p[1] << 8) | (p[2] << 16)));
+	v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+	return _mm_cvtepi32_ps(v);
+}
+
+// log2 for x > 0: exponent plus a degree 5 polynomial of the mantissa (error < 5e-5)
+static inline __m128 Log2(__m128 x)
+{
+	__m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	__m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))), _mm_set1_ps(1.0f));
+
+	__m128 p = _mm_set1_ps(0.0586649397f);
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.2251030255f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.4405990330f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.7167146632f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.4426038942f));
+	return _mm_add_ps(e, _mm_mul_ps(p, t));
+}
+
+// 2^y for -126 <= y <= 0: integer part into the exponent, degree 5 polynomial for the rest (relative error < 2e-7)
+static inline __m128 Exp2(__m128 y)
+{
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+	__m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, y), _mm_set1_ps(1.0f)));
+	__m128 f = _mm_sub_ps(y, floored);
+
+	__m128 p = _mm_set1_ps(0.0018937541f);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0089495904f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0558603371f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.2401418182f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.6931544897f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.9999998984f));
+
+	__m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(floored), _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(exponent));
+}
+#endif
+
+void PixelMapper::Sample(const uint8_t* frame)
+{
+	float* colors = m_Colors.data();
+	for (size_t i = 0; i < m_Samples.size(); i++)
+	{
+		const PixelSample& sample = m_Samples[i];
+#ifdef PIXEL_SSE2
+		__m128 color = _mm_mul_ps(LoadPixel(frame + sample.offsets[0]), _mm_set1_ps(sample.weights[0]));
+		color = _mm_add_ps(color, _mm_mul_ps(LoadPixel(frame + sample.offsets[1]), _mm_set1_ps(sample.weights[1])));
+		color = _mm_add_ps(color, _mm_mul_ps(LoadPixel(frame + sample.offsets[2]), _mm_set1_ps(sample.weights[2])));
+		color = _mm_add_ps(color, _mm_mul_ps(LoadPixel(frame + sample.offsets[3]), _mm_set1_ps(sample.weights[3])));
+		_mm_storeu_ps(colors + i * 4, color);
+#else
+		for (int c = 0; c < 3; c++)
+		{
+			colors[i * 4 + c] = frame[sample.offsets[0] + c] * sample.weights[0] + frame[sample.offsets[1] + c] * sample.weights[1] +
+				frame[sample.offsets[2] + c] * sample.weights[2] + frame[sample.offsets[3] + c] * sample.weights[3];
+		}
+		colors[i * 4 + 3] = 0.0f;
+#endif
+	}
+}
+
+void PixelMapper::Correct(const float* values, size_t count, float gamma, float brightness, uint8_t* out)
+{
+	brightness = Clamp01(brightness);
+#ifdef PIXEL_SSE2
+	const __m128 toUnit = _mm_set1_ps(1.0f / 255.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minExponent = _mm_set1_ps(-126.0f);
+	const __m128 exponent = _mm_set1_ps(gamma);
+	const __m128 scale = _mm_set1_ps(255.0f * brightness);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (size_t i = 0; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(values + i), toUnit), zero), one);
+		// v^gamma = 2^(gamma * log2(v)), zero ends up far below the smallest step
+		v = Exp2(_mm_max_ps(_mm_mul_ps(exponent, Log2(v)), minExponent));
+		__m128i result = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+		result = _mm_packs_epi32(result, result);
+		result = _mm_packus_epi16(result, result);
+		uint32_t packed = (uint32_t)_mm_cvtsi128_si32(result);
+		memcpy(out + i, &packed, 4);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		float v = Clamp01(values[i] / 255.0f);
+		out[i] = (uint8_t)(powf(v, gamma) * 255.0f * brightness + 0.5f);
+	}
+#endif
+}
+
+void PixelMapper::RunFrame(double dt)
+{
+	using namespace std::chrono;
+
+	if (!m_Playing)
+	{
+		return;
+	}
+
+	// The UI holds the lock only while it swaps the layout or the sequence, skip that frame
+	std::unique_lock<std::mutex> lock(m_Mutex, std::try_to_lock);
+	if (!lock.owns_lock() || !m_Sequence.IsOpen() || m_Fixtures.empty())
+	{
+		return;
+	}
+
+	steady_clock::time_point start = steady_clock::now();
+
+	uint32_t frameCount = m_Sequence.GetFrameCount();
+	m_Position += dt * m_Sequence.GetFrameRate();
+	if (m_Position >= frameCount)
+	{
+		if (m_Loop)
+		{
+			m_Position = fmod(m_Position, (double)frameCount);
+		}
+		else
+		{
+			m_Position = frameCount - 1;
+			m_Playing = false;
+		}
+	}
+	uint32_t index = (uint32_t)m_Position;
+
+	const uint8_t* frame = m_Sequence.GetFrame(index);
+	if (frame == nullptr)
+	{
+		return;
+	}
+	if (m_SampleWidth != m_Sequence.GetWidth() || m_SampleHeight != m_Sequence.GetHeight())
+	{
+		BuildSamples(m_Sequence.GetWidth(), m_Sequence.GetHeight());
+	}
+
+	Sample(frame);
+	Correct(m_Colors.data(), m_Colors.size(), m_Gamma, m_Brightness, m_Values.data());
+
+	uint64_t dirty = 0;
+	size_t universeCount;
+	uint8_t* universes = m_Scheduler->BeginWrite(&universeCount);
+	for (size_t i = 0; i < m_Fixtures.size(); i++)
+	{
+		const PixelFixture& fixture = m_Fixtures[i];
+		if (fixture.universe >= universeCount || fixture.start + fixture.channels > DMX_UNIVERSE_SIZE)
+		{
+			continue;
+		}
+
+		uint8_t* slots = universes + (size_t)fixture.universe * DMX_UNIVERSE_SIZE + fixture.start;
+		if (fixture.channels == PIXEL_LAYOUT_DRGB)
+		{
+			// Brightness is already in the color values, keep the dimmer open
+			*slots++ = 255;
+		}
+		memcpy(slots, &m_Values[i * 4], 3);
+		dirty |= 1ull << fixture.universe;
+	}
+	m_Scheduler->EndWrite(dirty);
+
+	// Page in the next frame now instead of faulting on it in the next tick
+	m_Sequence.Prefetch(index + 1 < frameCount ? index + 1 : 0);
+
+	m_FrameIndex = index;
+	m_RenderMicros = (uint32_t)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
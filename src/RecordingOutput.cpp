@@ -0,0 +1,96 @@
+#include "RecordingOutput.h"
+#include <windows.h>
+
+static bool WriteAll(HANDLE file, const void* data, size_t size)
+{
+	DWORD written = 0;
+	return WriteFile(file, data, (DWORD)size, &written, NULL) && written == size;
+}
+
+RecordingOutput::RecordingOutput() : m_File(INVALID_HANDLE_VALUE), m_UniverseCount(0), m_FrameCount(0), m_Failed(false)
+{
+
+}
+
+RecordingOutput::~RecordingOutput()
+{
+	Close();
+}
+
+Result RecordingOutput::Open(const std::string& path, uint32_t universeCount, uint32_t frameRate)
+{
+	Close();
+	if (universeCount == 0 || universeCount > DMX_MAX_UNIVERSES)
+	{
+		return RESULT_ERROR;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_File = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_ERROR;
+	}
+
+	CaptureFileHeader header;
+	header.magic = CAPTURE_FILE_MAGIC;
+	header.version = CAPTURE_FILE_VERSION;
+	header.universeCount = universeCount;
+	header.frameRate = frameRate;
+	if (!WriteAll(m_File, &header, sizeof(header)))
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+		return RESULT_ERROR;
+	}
+
+	m_UniverseCount = universeCount;
+	m_FrameCount = 0;
+	m_Failed = false;
+	return RESULT_SUCCESS;
+}
+
+Result RecordingOutput::Close()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_SUCCESS;
+	}
+	CloseHandle(m_File);
+	m_File = INVALID_HANDLE_VALUE;
+	return RESULT_SUCCESS;
+}
+
+bool RecordingOutput::IsOpen()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_File != INVALID_HANDLE_VALUE;
+}
+
+Result RecordingOutput::SendFrame(const uint8_t* universes, size_t universeCount)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_SUCCESS;
+	}
+
+	size_t present = universeCount < m_UniverseCount ? universeCount : m_UniverseCount;
+	bool ok = WriteAll(m_File, universes, present * DMX_UNIVERSE_SIZE);
+	static const uint8_t zeros[DMX_UNIVERSE_SIZE] = {};
+	for (size_t i = present; ok && i < m_UniverseCount; i++)
+	{
+		ok = WriteAll(m_File, zeros, sizeof(zeros));
+	}
+
+	if (!ok)
+	{
+		m_Failed = true;
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+		return RESULT_ERROR;
+	}
+	m_FrameCount++;
+	return RESULT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+#include "SceneStore.h"
+#include <windows.h>
+#include <string.h>
+
+SceneStore::SceneStore() : m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr), m_View(nullptr), m_ViewSize(0), m_UniverseCount(0), m_RecordSize(0)
+{
+
+}
+
+SceneStore::~SceneStore()
+{
+	Close();
+}
+
+Result SceneStore::Map(size_t size)
+{
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_File, &fileSize))
+	{
+		return RESULT_ERROR;
+	}
+
+	if ((size_t)fileSize.QuadPart < size)
+	{
+		LARGE_INTEGER end;
+		end.QuadPart = (LONGLONG)size;
+		if (!SetFilePointerEx(m_File, end, NULL, FILE_BEGIN) || !SetEndOfFile(m_File))
+		{
+			return RESULT_ERROR;
+		}
+	}
+
+	m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+	if (m_Mapping == nullptr)
+	{
+		return RESULT_ERROR;
+	}
+
+	m_View = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (m_View == nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+		return RESULT_ERROR;
+	}
+
+	m_ViewSize = size;
+	return RESULT_SUCCESS;
+}
+
+void SceneStore::Unmap()
+{
+	if (m_View != nullptr)
+	{
+		FlushViewOfFile(m_View, 0);
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+	}
+	if (m_Mapping != nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	m_ViewSize = 0;
+}
+
+Result SceneStore::Open(const std::string& path, size_t universeCount)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Release();
+
+	m_File = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return RESULT_ERROR;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_File, &fileSize))
+	{
+		Release();
+		return RESULT_ERROR;
+	}
+
+	if ((size_t)fileSize.QuadPart < sizeof(SceneFileHeader))
+	{
+		// New file
+		if (universeCount < 1)
+		{
+			universeCount = 1;
+		}
+		m_UniverseCount = universeCount;
+		m_RecordSize = sizeof(SceneRecord) + universeCount * DMX_UNIVERSE_SIZE;
+
+		if (Map(sizeof(SceneFileHeader) + SCENE_INITIAL_CAPACITY * m_RecordSize) == RESULT_ERROR)
+		{
+			Release();
+			return RESULT_ERROR;
+		}
+
+		SceneFileHeader* header = Header();
+		header->magic = SCENE_FILE_MAGIC;
+		header->version = SCENE_FILE_VERSION;
+		header->universeCount = (uint32_t)universeCount;
+		header->capacity = SCENE_INITIAL_CAPACITY;
+		header->count = 0;
+		header->recordSize = (uint32_t)m_RecordSize;
+		return RESULT_SUCCESS;
+	}
+
+	if (Map((size_t)fileSize.QuadPart) == RESULT_ERROR)
+	{
+		Release();
+		return RESULT_ERROR;
+	}
+
+	SceneFileHeader* header = Header();
+	if (header->magic != SCENE_FILE_MAGIC || header->version != SCENE_FILE_VERSION || header->universeCount < 1 ||
+		header->recordSize != sizeof(SceneRecord) + header->universeCount * DMX_UNIVERSE_SIZE ||
+		header->count > header->capacity ||
+		sizeof(SceneFileHeader) + (size_t)header->capacity * header->recordSize > m_ViewSize)
+	{
+		Release();
+		return RESULT_ERROR;
+	}
+
+	m_UniverseCount = header->universeCount;
+	m_RecordSize = header->recordSize;
+
+	for (uint32_t i = 0; i < header->count; i++)
+	{
+		SceneRecord* record = Record(i);
+		record->name[SCENE_NAME_LENGTH - 1] = 0;
+		m_ByNumber[record->number] = i;
+		if (record->name[0] != 0)
+		{
+			m_ByName[record->name] = i;
+		}
+	}
+
+	return RESULT_SUCCESS;
+}
+
+void SceneStore::Close()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Release();
+}
+
+void SceneStore::Release()
+{
+	Unmap();
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+	m_ByNumber.clear();
+	m_ByName.clear();
+}
+
+Result SceneStore::Grow()
+{
+	uint32_t capacity = Header()->capacity * 2;
+	Unmap();
+	if (Map(sizeof(SceneFileHeader) + (size_t)capacity * m_RecordSize) == RESULT_ERROR)
+	{
+		return RESULT_ERROR;
+	}
+	Header()->capacity = capacity;
+	return RESULT_SUCCESS;
+}
+
+Result SceneStore::Relayout(size_t universeCount)
+{
+	size_t oldSize = m_RecordSize;
+	size_t newSize = sizeof(SceneRecord) + universeCount * DMX_UNIVERSE_SIZE;
+	uint32_t capacity = Header()->capacity;
+	uint32_t count = Header()->count;
+
+	Unmap();
+	if (Map(sizeof(SceneFileHeader) + (size_t)capacity * newSize) == RESULT_ERROR)
+	{
+		return RESULT_ERROR;
+	}
+
+	// Back to front, every record only moves up and never onto one that is still to be moved
+	uint8_t* records = m_View + sizeof(SceneFileHeader);
+	for (uint32_t i = count; i-- > 0;)
+	{
+		uint8_t* to = records + (size_t)i * newSize;
+		memmove(to, records + (size_t)i * oldSize, oldSize);
+		memset(to + oldSize, 0, newSize - oldSize);
+		SceneRecord* record = (SceneRecord*)to;
+		if (record->universeCount == 0)
+		{
+			record->universeCount = (uint32_t)m_UniverseCount;
+		}
+	}
+
+	m_UniverseCount = universeCount;
+	m_RecordSize = newSize;
+	Header()->universeCount = (uint32_t)universeCount;
+	Header()->recordSize = (uint32_t)newSize;
+	FlushViewOfFile(m_View, 0);
+	return RESULT_SUCCESS;
+}
+
+Result SceneStore::Save(const std::string& name, uint32_t number, const uint8_t* universes, size_t universeCount, const SceneSettings& settings)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (!IsOpen())
+	{
+		return RESULT_ERROR;
+	}
+
+	// Stored names are cut to the record, compare them the same way
+	std::string stored = name.substr(0, SCENE_NAME_LENGTH - 1);
+	uint32_t index = FindByNumber(number);
+	uint32_t named = stored.empty() ? SCENE_NOT_FOUND : FindByName(stored);
+	if (named != SCENE_NOT_FOUND && named != index)
+	{
+		return RESULT_ERROR;
+	}
+
+	if (universeCount > DMX_MAX_UNIVERSES)
+	{
+		universeCount = DMX_MAX_UNIVERSES;
+	}
+	if (universeCount > m_UniverseCount && Relayout(universeCount) == RESULT_ERROR)
+	{
+		return RESULT_ERROR;
+	}
+
+	if (index == SCENE_NOT_FOUND)
+	{
+		if (Header()->count == Header()->capacity && Grow() == RESULT_ERROR)
+		{
+			return RESULT_ERROR;
+		}
+		index = Header()->count++;
+		m_ByNumber[number] = index;
+	}
+	else
+	{
+		// Older files may have the name twice, only drop the entry if it is this scene's
+		std::unordered_map<std::string, uint32_t>::iterator it = m_ByName.find(Record(index)->name);
+		if (it != m_ByName.end() && it->second == index)
+		{
+			m_ByName.erase(it);
+		}
+	}
+
+	SceneRecord* record = Record(index);
+	memset(record->name, 0, SCENE_NAME_LENGTH);
+	memcpy(record->name, stored.c_str(), stored.size());
+	record->number = number;
+	record->settings = settings;
+	if (!stored.empty())
+	{
+		m_ByName[stored] = index;
+	}
+
+	uint8_t* data = (uint8_t*)(record + 1);
+	size_t count = universeCount < m_UniverseCount ? universeCount : m_UniverseCount;
+	record->universeCount = (uint32_t)count;
+	memcpy(data, universes, count * DMX_UNIVERSE_SIZE);
+	memset(data + count * DMX_UNIVERSE_SIZE, 0, (m_UniverseCount - count) * DMX_UNIVERSE_SIZE);
+
+	FlushViewOfFile(record, m_RecordSize);
+	return RESULT_SUCCESS;
+}
+
+uint32_t SceneStore::FindByNumber(uint32_t number)
+{
+	std::unordered_map<uint32_t, uint32_t>::iterator it = m_ByNumber.find(number);
+	return it == m_ByNumber.end() ? SCENE_NOT_FOUND : it->second;
+}
+
+uint32_t SceneStore::FindByName(const std::string& name)
+{
+	std::unordered_map<std::string, uint32_t>::iterator it = m_ByName.find(name);
+	return it == m_ByName.end() ? SCENE_NOT_FOUND : it->second;
+}
+
+const SceneRecord* SceneStore::GetRecord(uint32_t index)
+{
+	if (!IsOpen() || index >= Header()->count)
+	{
+		return nullptr;
+	}
+	return Record(index);
+}
+
+size_t SceneStore::GetSceneUniverseCount(uint32_t index)
+{
+	const SceneRecord* record = GetRecord(index);
+	return record == nullptr ? 0 : RecordUniverses(record);
+}
+
+const uint8_t* SceneStore::GetUniverses(uint32_t index)
+{
+	const SceneRecord* record = GetRecord(index);
+	return record == nullptr ? nullptr : (const uint8_t*)(record + 1);
+}
+
+uint32_t SceneStore::Recall(uint32_t number, uint8_t* out, size_t universeCount)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	uint32_t index = FindByNumber(number);
+	const uint8_t* data = GetUniverses(index);
+	if (data == nullptr)
+	{
+		return SCENE_NOT_FOUND;
+	}
+	// Universes the scene does not know keep their levels
+	size_t stored = RecordUniverses(Record(index));
+	size_t count = universeCount < stored ? universeCount : stored;
+	memcpy(out, data, count * DMX_UNIVERSE_SIZE);
+	return index;
+}
+
+void SceneStore::Crossfade(uint32_t from, uint32_t to, float t, uint8_t* out, size_t universeCount)
+{
+	const uint8_t* a = GetUniverses(from);
+	const uint8_t* b = GetUniverses(to);
+	if (a == nullptr || b == nullptr)
+	{
+		return;
+	}
+
+	// 8.8 fixed point weight, so the inner loop is integer only and auto-vectorizes
+	int weight = (int)(t * 256.0f + 0.5f);
+	weight = weight < 0 ? 0 : (weight > 256 ? 256 : weight);
+
+	// Only what both scenes stored, past that the records hold Relayout() padding
+	size_t stored = GetSceneUniverseCount(from);
+	size_t storedTo = GetSceneUniverseCount(to);
+	stored = storedTo < stored ? storedTo : stored;
+	size_t count = (universeCount < stored ? universeCount : stored) * DMX_UNIVERSE_SIZE;
+	for (size_t i = 0; i < count; i++)
+	{
+		out[i] = (uint8_t)((a[i] * (256 - weight) + b[i] * weight) >> 8);
+	}
+}
\ No newline at end of file
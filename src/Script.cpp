@@ -1,38 +1,75 @@
 #include "Script.h"
-#include <iostream>
-#include <fstream>
 #include "DMXLuaLib.h"
-#include <Windows.h>
-#include <locale>
-#include <iostream>
-#include <sstream>
-#include "Application.h"
+#include "ScriptEngine.h"
+#include <stdio.h>
 
-std::wstring widen(const std::string& str)
+static const char* eventNames[SCRIPT_EVENT_COUNT] = { "onFrame", "onBeat", "onCue" };
+
+// onFrame(fn) / onBeat(fn) / onCue(fn), upvalues are the Script* and the event
+static int L_setHandler(lua_State* L)
+{
+	Script* script = (Script*)lua_touserdata(L, lua_upvalueindex(1));
+	int event = (int)lua_tonumber(L, lua_upvalueindex(2));
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	lua_pushvalue(L, 1);
+	script->SetHandler(event, luaL_ref(L, LUA_REGISTRYINDEX));
+	return 0;
+}
+
+// DMX_claim(universe, channel, count), only allowed in the script body
+static int L_claim(lua_State* L)
 {
-	std::wostringstream wstm;
-	const std::ctype<wchar_t>& ctfacet = std::use_facet<std::ctype<wchar_t>>(wstm.getloc());
-	for (size_t i = 0; i < str.size(); ++i)
-		wstm << ctfacet.widen(str[i]);
-	return wstm.str();
+	Script* script = (Script*)lua_touserdata(L, lua_upvalueindex(1));
+	if (DMXLuaLib::IsDispatching())
+	{
+		return luaL_error(L, "DMX_claim() can only be used in the script body");
+	}
+	lua_Integer universe = luaL_checkinteger(L, 1);
+	lua_Integer channel = luaL_checkinteger(L, 2);
+	lua_Integer count = luaL_checkinteger(L, 3);
+	if (universe < 0 || universe >= SCRIPT_MAX_UNIVERSES || channel < 1 || channel > DMX_UNIVERSE_SIZE || count < 1 || channel - 1 + count > DMX_UNIVERSE_SIZE)
+	{
+		return luaL_error(L, "DMX_claim: invalid range");
+	}
+	script->Claim((uint16_t)universe, (uint16_t)(channel - 1), (uint16_t)count);
+	return 0;
 }
 
-Script::Script(const std::string& path) : error(0)
+Script::Script(const std::string& path, int instance) : error(0)
 {
-	Application::INSTANCE->scriptActions.clear();
+	for (int i = 0; i < SCRIPT_EVENT_COUNT; i++)
+	{
+		m_Handlers[i] = LUA_NOREF;
+	}
+
 	L = luaL_newstate();
 	luaL_openlibs(L);
 	DMXLuaLib::LoadLib(L);
 
+	for (int i = 0; i < SCRIPT_EVENT_COUNT; i++)
+	{
+		lua_pushlightuserdata(L, this);
+		lua_pushinteger(L, i);
+		lua_pushcclosure(L, L_setHandler, 2);
+		lua_setglobal(L, eventNames[i]);
+	}
+	lua_pushlightuserdata(L, this);
+	lua_pushcclosure(L, L_claim, 1);
+	lua_setglobal(L, "DMX_claim");
+	lua_pushinteger(L, instance);
+	lua_setglobal(L, "scriptInstance");
+
 	if (luaL_dofile(L, path.c_str()) != 0) {
 		const char* errorMessage = lua_tostring(L, -1);
 		printf("Lua error: %s\n", errorMessage);
-		MessageBox(NULL, widen(errorMessage).c_str(), L"Lua Error", MB_OK | MB_ICONERROR);
+		m_Error = errorMessage != nullptr ? errorMessage : "unknown error";
 		lua_close(L);
 		L = nullptr;
+		for (int i = 0; i < SCRIPT_EVENT_COUNT; i++)
+		{
+			m_Handlers[i] = LUA_NOREF;
+		}
 	}
-
-	Application::INSTANCE->scriptActions.push_back("Done");
 }
 
 Script::~Script()
@@ -41,4 +78,88 @@ Script::~Script()
 	{
 		lua_close(L);
 	}
+}
+
+void Script::SetHandler(int event, int ref)
+{
+	if (m_Handlers[event] != LUA_NOREF && L != nullptr)
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, m_Handlers[event]);
+	}
+	m_Handlers[event] = ref;
+}
+
+void Script::Claim(uint16_t universe, uint16_t start, uint16_t count)
+{
+	ScriptClaim claim;
+	claim.universe = universe;
+	claim.start = start;
+	claim.count = count;
+	m_Claims.push_back(claim);
+}
+
+size_t Script::GetClaimedSlots()
+{
+	size_t slots = 0;
+	for (const ScriptClaim& claim : m_Claims)
+	{
+		slots += claim.count;
+	}
+	return slots;
+}
+
+bool Script::HasHandlers()
+{
+	for (int i = 0; i < SCRIPT_EVENT_COUNT; i++)
+	{
+		if (m_Handlers[i] != LUA_NOREF)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Script::Call(int event, int args)
+{
+	if (lua_pcall(L, args, 0, 0) != 0)
+	{
+		// No message box here, this runs on the output thread
+		printf("Lua error in %s: %s\n", eventNames[event], lua_tostring(L, -1));
+		lua_pop(L, 1);
+		SetHandler(event, LUA_NOREF);
+	}
+}
+
+void Script::OnFrame(double dt)
+{
+	if (m_Handlers[SCRIPT_EVENT_FRAME] == LUA_NOREF)
+	{
+		return;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_Handlers[SCRIPT_EVENT_FRAME]);
+	lua_pushnumber(L, dt);
+	Call(SCRIPT_EVENT_FRAME, 1);
+}
+
+void Script::OnBeat(int n)
+{
+	if (m_Handlers[SCRIPT_EVENT_BEAT] == LUA_NOREF)
+	{
+		return;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_Handlers[SCRIPT_EVENT_BEAT]);
+	lua_pushinteger(L, n);
+	Call(SCRIPT_EVENT_BEAT, 1);
+}
+
+void Script::OnCue(const char* name)
+{
+	if (m_Handlers[SCRIPT_EVENT_CUE] == LUA_NOREF)
+	{
+		return;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_Handlers[SCRIPT_EVENT_CUE]);
+	lua_pushstring(L, name);
+	Call(SCRIPT_EVENT_CUE, 1);
 }
\ No newline at end of file
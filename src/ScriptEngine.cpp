@@ -0,0 +1,424 @@
+#include "ScriptEngine.h"
+#include "DMXLuaLib.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+ScriptEngine::ScriptEngine(OutputScheduler* scheduler) : m_Scheduler(scheduler), m_WorkerCount(0), m_Generation(0), m_Remaining(0), m_Stopping(false),
+	m_FrameDelta(0.0), m_FrameFirstBeat(0), m_FrameBeats(0), m_PendingBeats(0), m_CueCount(0), m_OwnBeats(0), m_BeatsPerMinute(0.0f), m_FrameMicros(0), m_BeatPhase(0.0), m_BeatCount(0)
+{
+	for (size_t i = 0; i < SCRIPT_MAX_WORKERS; i++)
+	{
+		m_WorkerMicros[i] = 0;
+		m_WorkerScripts[i] = 0;
+	}
+	for (size_t i = 0; i < SCRIPT_MAX_PARAMETERS; i++)
+	{
+		m_Parameters[i] = 0.0f;
+	}
+	SetWorkerCount(0);
+}
+
+ScriptEngine::~ScriptEngine()
+{
+	Clear();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	StopWorkers();
+}
+
+void ScriptEngine::StartWorkers(size_t count)
+{
+	m_Stopping = false;
+	m_WorkerCount = count;
+	for (size_t i = 0; i < count; i++)
+	{
+		ScriptWorker* worker = new ScriptWorker();
+		worker->buffer.assign(SCRIPT_MAX_UNIVERSES * DMX_UNIVERSE_SIZE, 0);
+		m_Workers.push_back(worker);
+	}
+	// Threads start after all workers exist, RunWorker indexes into m_Workers
+	for (size_t i = 0; i < count; i++)
+	{
+		m_Workers[i]->thread = new std::thread(&ScriptEngine::RunWorker, this, i, m_Generation);
+	}
+}
+
+void ScriptEngine::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_FrameMutex);
+		m_Stopping = true;
+	}
+	m_StartCondition.notify_all();
+
+	for (ScriptWorker* worker : m_Workers)
+	{
+		worker->thread->join();
+		delete worker->thread;
+		delete worker;
+	}
+	m_Workers.clear();
+	m_WorkerCount = 0;
+}
+
+void ScriptEngine::SetWorkerCount(size_t count)
+{
+	if (count == 0)
+	{
+		// Leave one core for the output, UI and discovery threads
+		unsigned int cores = std::thread::hardware_concurrency();
+		count = cores > 1 ? cores - 1 : 1;
+	}
+	count = std::min<size_t>(count, SCRIPT_MAX_WORKERS);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (count == m_WorkerCount)
+	{
+		return;
+	}
+	StopWorkers();
+	StartWorkers(count);
+	Reassign();
+}
+
+void ScriptEngine::Add(Script* script)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (std::find(m_Scripts.begin(), m_Scripts.end(), script) == m_Scripts.end())
+	{
+		m_Scripts.push_back(script);
+		Reassign();
+	}
+}
+
+void ScriptEngine::Remove(Script* script)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	std::vector<Script*>::iterator it = std::find(m_Scripts.begin(), m_Scripts.end(), script);
+	if (it == m_Scripts.end())
+	{
+		return;
+	}
+	m_Scripts.erase(it);
+	delete script;
+	Reassign();
+}
+
+void ScriptEngine::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (Script* script : m_Scripts)
+	{
+		delete script;
+	}
+	m_Scripts.clear();
+	Reassign();
+}
+
+size_t ScriptEngine::GetScriptCount()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Scripts.size();
+}
+
+static bool ClaimsOverlap(const std::vector<ScriptClaim>& a, const std::vector<ScriptClaim>& b)
+{
+	for (const ScriptClaim& x : a)
+	{
+		for (const ScriptClaim& y : b)
+		{
+			if (x.universe == y.universe && x.start < y.start + y.count && y.start < x.start + x.count)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ScriptEngine::Reassign()
+{
+	// Called with m_Mutex held, so no frame is running
+
+	size_t count = m_Scripts.size();
+	std::vector<size_t> group(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		group[i] = i;
+	}
+
+	// Scripts writing the same slots must share a worker, so merge them into one
+	// group (repeat until stable, the script count is small). Unclaimed scripts
+	// always form a single group.
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 0; i < count; i++)
+		{
+			for (size_t j = i + 1; j < count; j++)
+			{
+				if (group[i] == group[j])
+				{
+					continue;
+				}
+				const std::vector<ScriptClaim>& a = m_Scripts[i]->GetClaims();
+				const std::vector<ScriptClaim>& b = m_Scripts[j]->GetClaims();
+				if ((a.empty() && b.empty()) || ClaimsOverlap(a, b))
+				{
+					size_t from = std::max(group[i], group[j]);
+					size_t to = std::min(group[i], group[j]);
+					for (size_t k = 0; k < count; k++)
+					{
+						if (group[k] == from)
+						{
+							group[k] = to;
+						}
+					}
+					changed = true;
+				}
+			}
+		}
+	}
+
+	struct Group
+	{
+		size_t id;
+		size_t load;
+		bool pinned;
+	};
+	std::vector<Group> groups;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::vector<Group>::iterator it = std::find_if(groups.begin(), groups.end(), [&](const Group& g) { return g.id == group[i]; });
+		if (it == groups.end())
+		{
+			Group g = { group[i], 0, false };
+			groups.push_back(g);
+			it = groups.end() - 1;
+		}
+		size_t slots = m_Scripts[i]->GetClaimedSlots();
+		it->load += slots > 0 ? slots : DMX_UNIVERSE_SIZE;
+		it->pinned = it->pinned || slots == 0;
+	}
+
+	// Largest group first onto the least loaded worker
+	std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) { return a.load > b.load; });
+
+	std::vector<size_t> load(m_Workers.size(), 0);
+	for (ScriptWorker* worker : m_Workers)
+	{
+		worker->scripts.clear();
+	}
+	for (const Group& g : groups)
+	{
+		size_t target = 0;
+		if (!g.pinned)
+		{
+			target = std::min_element(load.begin(), load.end()) - load.begin();
+		}
+		load[target] += g.load;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (group[i] == g.id)
+			{
+				m_Workers[target]->scripts.push_back(m_Scripts[i]);
+			}
+		}
+	}
+
+	// Start every private buffer from the current output, so scripts that moved
+	// to another worker keep their values until they write again
+	size_t universeCount;
+	uint8_t* universes = m_Scheduler->BeginWrite(&universeCount);
+	size_t bytes = std::min<size_t>(universeCount, SCRIPT_MAX_UNIVERSES) * DMX_UNIVERSE_SIZE;
+	for (size_t i = 0; i < m_Workers.size(); i++)
+	{
+		memcpy(m_Workers[i]->buffer.data(), universes, bytes);
+		m_WorkerScripts[i] = (uint32_t)m_Workers[i]->scripts.size();
+	}
+	m_Scheduler->EndWrite(0);
+	for (size_t i = m_Workers.size(); i < SCRIPT_MAX_WORKERS; i++)
+	{
+		m_WorkerScripts[i] = 0;
+		m_WorkerMicros[i] = 0;
+	}
+}
+
+void ScriptEngine::Beat()
+{
+	std::lock_guard<std::mutex> lock(m_EventMutex);
+	m_PendingBeats++;
+}
+
+void ScriptEngine::Cue(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_EventMutex);
+	m_PendingCues.push_back(name);
+}
+
+bool ScriptEngine::FrameCue(const char* name)
+{
+	if (m_CueCount == SCRIPT_MAX_CUES)
+	{
+		return false;
+	}
+	char* cue = m_Cues[m_CueCount++];
+	size_t length = 0;
+	while (length < SCRIPT_CUE_NAME_LENGTH - 1 && name[length] != 0)
+	{
+		cue[length] = name[length];
+		length++;
+	}
+	cue[length] = 0;
+	return true;
+}
+
+void ScriptEngine::ResetBeats()
+{
+	std::lock_guard<std::mutex> lock(m_EventMutex);
+	m_PendingBeats = 0;
+	m_PendingCues.clear();
+	m_OwnBeats = 0;
+	m_CueCount = 0;
+	m_BeatPhase = 0.0;
+	m_BeatCount = 0;
+}
+
+void ScriptEngine::RunWorker(size_t index, uint64_t generation)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_FrameMutex);
+			m_StartCondition.wait(lock, [&]() { return m_Stopping || m_Generation != generation; });
+			if (m_Stopping)
+			{
+				return;
+			}
+			generation = m_Generation;
+		}
+
+		RenderWorker(index);
+
+		{
+			std::lock_guard<std::mutex> lock(m_FrameMutex);
+			if (--m_Remaining == 0)
+			{
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+}
+
+void ScriptEngine::RenderWorker(size_t index)
+{
+	using namespace std::chrono;
+	steady_clock::time_point start = steady_clock::now();
+
+	ScriptWorker* worker = m_Workers[index];
+	DMXLuaLib::SetDispatching(true);
+
+	for (Script* script : worker->scripts)
+	{
+		DMXLuaLib::SetFrameTarget(worker->buffer.data(), &script->GetClaims());
+		for (int i = 0; i < m_FrameBeats; i++)
+		{
+			script->OnBeat(m_FrameFirstBeat + i);
+		}
+		for (size_t i = 0; i < m_CueCount; i++)
+		{
+			script->OnCue(m_Cues[i]);
+		}
+		script->OnFrame(m_FrameDelta);
+	}
+
+	DMXLuaLib::SetFrameTarget(nullptr, nullptr);
+	DMXLuaLib::SetDispatching(false);
+	m_WorkerMicros[index] = (uint32_t)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+void ScriptEngine::RunFrame(double dt)
+{
+	using namespace std::chrono;
+	steady_clock::time_point start = steady_clock::now();
+
+	int beats = m_OwnBeats;
+	m_OwnBeats = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_EventMutex);
+		beats += m_PendingBeats;
+		m_PendingBeats = 0;
+		for (const std::string& cue : m_PendingCues)
+		{
+			FrameCue(cue.c_str());
+		}
+		// clear() keeps the capacity, so steady state needs no allocation
+		m_PendingCues.clear();
+	}
+
+	float bpm = m_BeatsPerMinute;
+	if (bpm > 0.0f)
+	{
+		m_BeatPhase += dt * bpm / 60.0;
+		while (m_BeatPhase >= 1.0)
+		{
+			m_BeatPhase -= 1.0;
+			beats++;
+		}
+	}
+	else
+	{
+		m_BeatPhase = 0.0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Scripts.empty() || m_Workers.empty())
+	{
+		m_BeatCount += beats;
+		m_CueCount = 0;
+		m_FrameMicros = 0;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> frameLock(m_FrameMutex);
+		m_FrameDelta = dt;
+		m_FrameFirstBeat = m_BeatCount + 1;
+		m_FrameBeats = beats;
+		m_Remaining = m_Workers.size();
+		m_Generation++;
+	}
+	m_BeatCount += beats;
+	m_StartCondition.notify_all();
+
+	{
+		std::unique_lock<std::mutex> frameLock(m_FrameMutex);
+		m_DoneCondition.wait(frameLock, [this]() { return m_Remaining == 0; });
+	}
+
+	// Every claimed range has exactly one owner, so the merge is plain copies
+	size_t universeCount;
+	uint64_t dirty = 0;
+	uint8_t* universes = m_Scheduler->BeginWrite(&universeCount);
+	for (ScriptWorker* worker : m_Workers)
+	{
+		for (Script* script : worker->scripts)
+		{
+			for (const ScriptClaim& claim : script->GetClaims())
+			{
+				if (claim.universe >= universeCount)
+				{
+					continue;
+				}
+				size_t offset = (size_t)claim.universe * DMX_UNIVERSE_SIZE + claim.start;
+				memcpy(universes + offset, worker->buffer.data() + offset, claim.count);
+				dirty |= 1ull << claim.universe;
+			}
+		}
+	}
+	m_Scheduler->EndWrite(dirty);
+
+	m_CueCount = 0;
+	m_FrameMicros = (uint32_t)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
\ No newline at end of file
@@ -65,6 +65,7 @@ Result SerialComm::Open(const std::string* device, uint32_t baud_rate)
     }
 
     m_Handle = port;
+    m_Open = true;
     return RESULT_SUCCESS;
 }
 
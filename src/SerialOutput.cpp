@@ -0,0 +1,84 @@
+#include "SerialOutput.h"
+
+SerialOutput::SerialOutput(SerialComm* comm) : m_Comm(comm), m_ColorOffset(std::string::npos), m_Failed(false), m_Compress(false)
+{
+
+}
+
+void SerialOutput::QueueMessage(const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Pending.append(message);
+	m_ColorOffset = std::string::npos;
+}
+
+void SerialOutput::QueueColor(const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_ColorOffset != std::string::npos)
+	{
+		// The last queued message is an unsent color, only the newest one matters
+		m_Pending.erase(m_ColorOffset);
+	}
+	m_ColorOffset = m_Pending.size();
+	m_Pending.append(message);
+	m_LastColor = message;
+}
+
+void SerialOutput::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Pending.clear();
+	m_ColorOffset = std::string::npos;
+	m_Failed = false;
+	// The receiver may have been reset, deltas need a keyframe to apply to
+	m_Encoder.ForceKeyframe();
+}
+
+void SerialOutput::SetCompression(bool enabled)
+{
+	if (enabled && !m_Compress)
+	{
+		m_Encoder.ForceKeyframe();
+	}
+	m_Compress = enabled;
+}
+
+void SerialOutput::ReplayColor()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_LastColor.empty())
+	{
+		return;
+	}
+	m_ColorOffset = m_Pending.size();
+	m_Pending.append(m_LastColor);
+}
+
+Result SerialOutput::SendFrame(const uint8_t* universes, size_t universeCount)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Sending.swap(m_Pending);
+		m_ColorOffset = std::string::npos;
+	}
+
+	if (m_Compress && universeCount > 0)
+	{
+		m_Encoder.Encode(universes, m_Sending);
+	}
+
+	if (m_Sending.empty())
+	{
+		return RESULT_SUCCESS;
+	}
+
+	Result result = m_Comm->Write((uint8_t*)m_Sending.data(), m_Sending.size());
+	m_Sending.clear();
+	if (result == RESULT_ERROR)
+	{
+		m_Failed = true;
+		m_Encoder.ForceKeyframe();
+	}
+	return result;
+}
\ No newline at end of file
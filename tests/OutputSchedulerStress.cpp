@@ -0,0 +1,133 @@
+// Stress test for the OutputScheduler triple buffer. Portable (no windows.h), meant
+// to be built with ThreadSanitizer:
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -Iinclude tests/OutputSchedulerStress.cpp src/OutputScheduler.cpp src/Clock.cpp -o stress
+//   ./stress [seconds]
+//
+// Writers fill whole universes with one value per write, through SetChannels(),
+// BeginWrite()/EndWrite() and the frame callback, while another thread keeps
+// changing the universe count. Every frame the outputs get must consist of whole
+// writes only: a universe with two different values in it was torn.
+#include <OutputScheduler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#define STRESS_FPS 2000
+#define STRESS_WRITERS 3
+
+class CheckingOutput : public DMXOutput
+{
+public:
+	std::atomic<uint64_t> frames{ 0 };
+	std::atomic<uint64_t> torn{ 0 };
+	std::atomic<uint64_t> badCounts{ 0 };
+
+	Result SendFrame(const uint8_t* universes, size_t universeCount) override
+	{
+		frames++;
+		if (universeCount < 1 || universeCount > DMX_MAX_UNIVERSES)
+		{
+			badCounts++;
+			return RESULT_ERROR;
+		}
+		for (size_t u = 0; u < universeCount; u++)
+		{
+			const uint8_t* slots = universes + u * DMX_UNIVERSE_SIZE;
+			for (size_t i = 1; i < DMX_UNIVERSE_SIZE; i++)
+			{
+				if (slots[i] != slots[0])
+				{
+					torn++;
+					break;
+				}
+			}
+		}
+		return RESULT_SUCCESS;
+	}
+};
+
+static void Fill(uint8_t* universes, size_t universe, uint8_t value)
+{
+	memset(universes + universe * DMX_UNIVERSE_SIZE, value, DMX_UNIVERSE_SIZE);
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+
+	RealClock clock;
+	OutputScheduler scheduler(&clock);
+	CheckingOutput output;
+	scheduler.AddOutput(&output);
+	scheduler.SetUniverseCount(DMX_MAX_UNIVERSES);
+
+	// The frame callback writes like the script engine merge does
+	uint8_t callbackValue = 0;
+	scheduler.SetFrameCallback([&](double) {
+		size_t count;
+		uint8_t* universes = scheduler.BeginWrite(&count);
+		Fill(universes, 0, ++callbackValue);
+		scheduler.EndWrite(1);
+	});
+	scheduler.Start(STRESS_FPS);
+
+	std::atomic<bool> running{ true };
+	std::atomic<uint64_t> writes{ 0 };
+	std::thread* writers[STRESS_WRITERS];
+	for (int w = 0; w < STRESS_WRITERS; w++)
+	{
+		writers[w] = new std::thread([&, w]() {
+			uint8_t buffer[DMX_UNIVERSE_SIZE];
+			uint32_t value = 0;
+			while (running)
+			{
+				value++;
+				size_t universe = 1 + (value * 7 + w) % (DMX_MAX_UNIVERSES - 1);
+				if (w == 0)
+				{
+					// Single universe writes
+					memset(buffer, (uint8_t)value, sizeof(buffer));
+					scheduler.SetChannels(universe, 0, buffer, sizeof(buffer));
+				}
+				else
+				{
+					// Bulk writes over every universe, like a scene recall
+					size_t count;
+					uint8_t* universes = scheduler.BeginWrite(&count);
+					for (size_t u = 1; u < count; u++)
+					{
+						Fill(universes, u, (uint8_t)(value + u));
+					}
+					scheduler.EndWrite(w == 1 ? OUTPUT_ALL_UNIVERSES : 1ull << (universe < count ? universe : 0));
+				}
+				writes++;
+			}
+		});
+	}
+	std::thread resizer([&]() {
+		uint32_t step = 0;
+		while (running)
+		{
+			scheduler.SetUniverseCount(1 + (step++ * 13) % DMX_MAX_UNIVERSES);
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	});
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	running = false;
+	for (int w = 0; w < STRESS_WRITERS; w++)
+	{
+		writers[w]->join();
+		delete writers[w];
+	}
+	resizer.join();
+	scheduler.Stop();
+
+	printf("%llu frames, %llu writes, %llu torn universes, %llu bad universe counts\n", (unsigned long long)output.frames, (unsigned long long)writes,
+		(unsigned long long)output.torn, (unsigned long long)output.badCounts);
+	return output.frames > 0 && output.torn == 0 && output.badCounts == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// Scaling benchmark for the ScriptEngine workers, runs without the Application:
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude -I<lua>/include tests/ScriptEngineBenchmark.cpp src/ScriptEngine.cpp src/Script.cpp
+//       src/DMXLuaFrame.cpp src/OutputScheduler.cpp src/Clock.cpp -L<lua>/lib -llua -ldl -o benchmark
+//   ./benchmark [scripts] [frames] [script]
+//
+// Loads scripts/Benchmark.lua the given number of times (every instance claims its
+// own 64 channel block, eight per universe), then renders the same frames with
+// 1..scripts workers and prints the frame time per worker count. Needs a machine
+// with at least as many cores as workers to show the scaling.
+#include <ScriptEngine.h>
+#include <DMXLuaLib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#define BENCHMARK_WARMUP_FRAMES 20
+#define BENCHMARK_BLOCKS_PER_UNIVERSE 8
+#define BENCHMARK_FRAME_DELTA (1.0 / 44.0)
+
+static OutputScheduler* benchmarkScheduler = nullptr;
+
+static int L_DMX_getUniverses(lua_State* L)
+{
+	lua_pushinteger(L, (lua_Integer)benchmarkScheduler->GetUniverseCount());
+	return 1;
+}
+
+// Stands in for DMXLuaLib.cpp, which needs the Application
+void DMXLuaLib::LoadLib(lua_State* L)
+{
+	LoadFrameLib(L);
+	lua_pushcfunction(L, L_DMX_getUniverses);
+	lua_setglobal(L, "DMX_getUniverses");
+}
+
+int main(int argc, char** argv)
+{
+	int scriptCount = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+	int frames = argc > 2 ? atoi(argv[2]) : 200;
+	const char* path = argc > 3 ? argv[3] : "scripts/Benchmark.lua";
+	if (scriptCount < 1)
+	{
+		scriptCount = 1;
+	}
+	if (scriptCount > SCRIPT_MAX_WORKERS)
+	{
+		scriptCount = SCRIPT_MAX_WORKERS;
+	}
+
+	// Not started, RunFrame() is driven from here
+	RealClock clock;
+	OutputScheduler scheduler(&clock);
+	benchmarkScheduler = &scheduler;
+	scheduler.SetUniverseCount((scriptCount + BENCHMARK_BLOCKS_PER_UNIVERSE - 1) / BENCHMARK_BLOCKS_PER_UNIVERSE);
+
+	ScriptEngine engine(&scheduler);
+	for (int i = 0; i < scriptCount; i++)
+	{
+		Script* script = new Script(path, i);
+		if (!script->GetError().empty() || !script->HasHandlers())
+		{
+			printf("%s: instance %d did not load\n", path, i);
+			delete script;
+			return 1;
+		}
+		engine.Add(script);
+	}
+
+	printf("%d scripts, %zu universes, %d frames\n", scriptCount, scheduler.GetUniverseCount(), frames);
+	printf("workers   ms/frame   speedup   scripts on the busiest worker\n");
+	double single = 0.0;
+	for (int workers = 1; workers <= scriptCount; workers++)
+	{
+		engine.SetWorkerCount((size_t)workers);
+		for (int i = 0; i < BENCHMARK_WARMUP_FRAMES; i++)
+		{
+			engine.RunFrame(BENCHMARK_FRAME_DELTA);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; i++)
+		{
+			engine.RunFrame(BENCHMARK_FRAME_DELTA);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+		if (workers == 1)
+		{
+			single = ms;
+		}
+		// Overlapping claims would put every script on one worker
+		uint32_t busiest = 0;
+		for (int i = 0; i < workers; i++)
+		{
+			if (engine.GetWorkerScriptCount((size_t)i) > busiest)
+			{
+				busiest = engine.GetWorkerScriptCount((size_t)i);
+			}
+		}
+		printf("%7d %10.3f %9.2fx %8u\n", workers, ms, single / ms, busiest);
+	}
+	return 0;
+}